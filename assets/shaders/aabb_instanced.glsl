@@ -0,0 +1,37 @@
+#type VERTEX_SHADER
+#version 450 core
+
+// one instance per AABB: .xy is the min corner, .zw the max corner
+layout(location = 0) in vec4 a_aabb;
+
+uniform mat4 u_view_projection_matrix = mat4(1.0);
+
+// the four edges of the box as GL_LINES, in [0 .. 1] box coordinates
+const vec2 corners[8] = vec2[8](
+	vec2(0.0, 0.0), vec2(1.0, 0.0),
+	vec2(0.0, 1.0), vec2(1.0, 1.0),
+	vec2(0.0, 0.0), vec2(0.0, 1.0),
+	vec2(1.0, 0.0), vec2(1.0, 1.0)
+);
+
+//
+void main()
+{
+	vec2 p = mix(a_aabb.xy, a_aabb.zw, corners[gl_VertexID]);
+	gl_Position = u_view_projection_matrix * vec4(p, 0.0, 1.0);
+}
+
+
+#type FRAGMENT_SHADER
+#version 450 core
+
+layout(location = 0) out vec4 out_color;
+
+uniform vec4 u_color = vec4(1.0);
+
+//
+void main()
+{
+	out_color = u_color;
+}
+
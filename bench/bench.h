@@ -0,0 +1,76 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "src/quadtree.h"
+#include "tests/test.h"
+
+
+// Timings for the headless bench runner (bench/main.cpp). BENCH() defines a benchmark
+// function and registers it before main(); benchmarks print their own results. The
+// vertex count of benchVertices() is set from the command line.
+typedef void (*BenchFnc)();
+
+struct BenchCase
+{
+    const char *name;
+    BenchFnc fnc;
+};
+
+std::vector<BenchCase> &benchCases();
+size_t benchVertexCount();
+
+struct BenchRegistrar
+{
+    BenchRegistrar(const char *_name, BenchFnc _fnc) { benchCases().push_back({ _name, _fnc }); }
+};
+
+#define BENCH(_name) \
+    static void _name(); \
+    static BenchRegistrar _name##_registrar(#_name, _name); \
+    static void _name()
+
+// Wall-clock timer, started on construction; getDeltaTimeMs() restarts it
+class BenchTimer
+{
+public:
+    BenchTimer() : m_t0(std::chrono::high_resolution_clock::now()) {}
+
+    float getDeltaTimeMs()
+    {
+        auto t = std::chrono::high_resolution_clock::now();
+        float ms = std::chrono::duration<float, std::milli>(t - m_t0).count();
+        m_t0 = t;
+        return ms;
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point m_t0;
+
+};
+
+// The distribution of layer::__debug_setup_async() (benchVertexCount() vertices in 1000
+// clusters), seeded
+inline std::vector<glm::vec2> benchVertices()
+{
+    size_t n = benchVertexCount();
+    size_t clusters = std::min(n, (size_t)1000);
+    return clusteredVertices(clusters, n / clusters, 0.05f);
+}
+
+// A tree of benchVertices(), built by a batch insert
+inline std::shared_ptr<QuadtreeBH> benchTree(const std::vector<glm::vec2> &_vertices,
+                                             QuadtreeFlags _flags=QUADTREE_DEFAULT)
+{
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(_vertices.size(), AABB2(), _flags);
+    qt->insert(qt, _vertices.data(), _vertices.size());
+    return qt;
+}
+
+
+#endif // __BENCH_H
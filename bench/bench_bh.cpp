@@ -0,0 +1,47 @@
+#include <stdio.h>
+
+#include "bench.h"
+
+
+//---------------------------------------------------------------------------------------
+// Barnes-Hut interaction lists through approxBH() (four children tested at a time), and
+// the same interaction counts through a BHVisitor, without materializing the lists
+BENCH(bench_bh)
+{
+    std::vector<glm::vec2> vertices = benchVertices();
+    std::shared_ptr<QuadtreeBH> qt = benchTree(vertices);
+    size_t n = std::min(vertices.size(), (size_t)100000);
+    size_t stride = vertices.size() / n;
+
+    std::vector<glm::vec3> v_BH;
+    size_t interactions = 0;
+    BenchTimer t0;
+    for (size_t i = 0; i < n; i++)
+    {
+        v_BH.clear();
+        qt->approxBH(qt, vertices[i * stride], v_BH);
+        interactions += v_BH.size();
+    }
+    float ms = t0.getDeltaTimeMs();
+    printf("    approxBH: %zu queries (theta = %g, %zu interactions/query) in %.3fms, %.3fus/query\n",
+           n, s_thetaBH, interactions / n, ms, 1000.0f * ms / n);
+
+    struct BHCountVisitor : BHVisitor
+    {
+        BHCountVisitor(const glm::vec2 &_v) : BHVisitor(_v, BHOpening(s_thetaBH)) {}
+        void visitNode(QuadtreeBH *_qt) { n += (_qt->getVertexCount() != 0); }
+        void visitPoint(const glm::vec2 &) { n++; }
+        size_t n = 0;
+    };
+    interactions = 0;
+    BenchTimer t1;
+    for (size_t i = 0; i < n; i++)
+    {
+        BHCountVisitor visitor(vertices[i * stride]);
+        qt->traverse(qt, visitor);
+        interactions += visitor.n;
+    }
+    ms = t1.getDeltaTimeMs();
+    printf("    BHVisitor: %zu queries (%zu interactions/query) in %.3fms, %.3fus/query\n",
+           n, interactions / n, ms, 1000.0f * ms / n);
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "bench.h"
+#include "src/parallel.h"
+
+
+//---------------------------------------------------------------------------------------
+// Accuracy against cost of the Barnes-Hut opening criteria: RMS relative force error
+// against direct summation, interactions and time per query, for each criterion over
+// its parameter (theta, or alpha for the relative criterion), on 1000 query vertices
+BENCH(bench_criteria)
+{
+    std::vector<glm::vec2> vertices = benchVertices();
+    std::shared_ptr<QuadtreeBH> qt = benchTree(vertices);
+    size_t n = std::min(vertices.size(), (size_t)1000);
+    size_t stride = vertices.size() / n;
+    const float softening = 1e-3f;
+    const float eps2 = softening * softening;
+
+    std::vector<glm::vec2> queries(n), a_ref(n, glm::vec2(0.0f));
+    parallel_for(n, [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+        {
+            queries[i] = vertices[i * stride];
+            for (auto &w : vertices)
+            {
+                glm::vec2 d = w - queries[i];
+                float r2 = glm::dot(d, d) + eps2;
+                a_ref[i] += d / (r2 * sqrtf(r2));
+            }
+        }
+    }, 1);
+
+    struct criterion_t { BHCriterion criterion; const char *name; std::vector<float> params; };
+    std::vector<criterion_t> criteria =
+    {
+        { BH_CRITERION_GEOMETRIC, "geometric", { 1.0f, 0.75f, 0.5f, 0.25f } },
+        { BH_CRITERION_BMAX,      "bmax",      { 1.0f, 0.75f, 0.5f, 0.25f } },
+        { BH_CRITERION_RELATIVE,  "relative",  { 0.02f, 0.005f, 0.002f, 0.0005f } },
+    };
+
+    printf("    %-10s %10s %12s %14s %12s\n", "criterion", "parameter", "rms error",
+           "interactions", "us/query");
+    std::vector<glm::vec3> v_BH;
+    for (auto &c : criteria)
+    {
+        for (float param : c.params)
+        {
+            BHOpening opening(c.criterion, param, param);
+            double err2 = 0.0;
+            BenchTimer t;
+            for (size_t i = 0; i < n; i++)
+            {
+                // relative criterion: the exact |a| stands in for the previous step's
+                opening.accel = glm::length(a_ref[i]);
+                glm::vec2 a = qt->accelerationBH(qt, queries[i], opening, softening);
+                float e = glm::length(a - a_ref[i]) / std::max(glm::length(a_ref[i]), 1e-30f);
+                err2 += e * e;
+            }
+            float ms = t.getDeltaTimeMs();
+
+            size_t interactions = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                opening.accel = glm::length(a_ref[i]);
+                v_BH.clear();
+                qt->approxBH(qt, queries[i], opening, v_BH);
+                interactions += v_BH.size();
+            }
+            printf("    %-10s %10g %12.3e %14.1f %12.3f\n", c.name, param, sqrt(err2 / n),
+                   (double)interactions / n, 1000.0f * ms / n);
+        }
+    }
+}
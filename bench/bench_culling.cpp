@@ -0,0 +1,40 @@
+#include <stdio.h>
+
+#include "bench.h"
+
+
+//---------------------------------------------------------------------------------------
+// Full extraction (as the renderer did before culling) against culled extraction into
+// preallocated buffers, for shrinking views centered on the first vertex
+BENCH(bench_culling)
+{
+    std::vector<glm::vec2> input = benchVertices();
+    std::shared_ptr<QuadtreeBH> qt = benchTree(input);
+
+    BenchTimer t0;
+    std::vector<glm::vec2> vertices, aabbs;
+    qt->getVertices(qt, vertices);
+    qt->getAABBLines(qt, aabbs);
+    printf("    full: %zu vertices, %zu AABBs in %.3fms\n", vertices.size(), aabbs.size() / 8,
+           t0.getDeltaTimeMs());
+
+    // compact AABB export (1 vec4 per leaf instead of 8 vec2 line vertices)
+    BenchTimer t1;
+    std::vector<glm::vec4> aabbs_compact;
+    qt->getAABBs(qt, aabbs_compact);
+    printf("    compact: %zu AABBs in %.3fms\n", aabbs_compact.size(), t1.getDeltaTimeMs());
+
+    std::vector<glm::vec2> v_buffer(vertices.size());
+    std::vector<glm::vec2> aabb_buffer(aabbs.size());
+    glm::vec2 c = vertices.size() ? vertices[0] : glm::vec2(0.0f);
+    for (float e : { 1.0f, 0.5f, 0.1f, 0.01f })
+    {
+        AABB2 view(c - glm::vec2(e), c + glm::vec2(e));
+        size_t v_count = 0, aabb_count = 0;
+        BenchTimer t2;
+        qt->getVertices(qt, view, v_buffer.data(), v_buffer.size(), v_count);
+        qt->getAABBLines(qt, view, aabb_buffer.data(), aabb_buffer.size(), aabb_count);
+        printf("    culled (extent %g): %zu vertices, %zu AABBs in %.3fms\n", e, v_count, aabb_count / 8,
+               t2.getDeltaTimeMs());
+    }
+}
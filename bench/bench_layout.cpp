@@ -0,0 +1,59 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "src/perf_counter.h"
+
+
+//---------------------------------------------------------------------------------------
+// Full-tree export and Barnes-Hut queries on the tree as built by single inserts (nodes
+// scattered over the heap, as in the application), then on copies compacted into each
+// layout: time and, if perf counters are available, cache misses
+BENCH(bench_layout)
+{
+    std::vector<glm::vec2> vertices = benchVertices();
+    size_t n = std::min(vertices.size(), (size_t)20000);
+    size_t stride = vertices.size() / n;
+
+    const char *names[] = { "as built", "DFS", "BFS", "vEB" };
+    PerfCounter counter;
+    std::vector<glm::vec3> v_BH;
+    std::vector<glm::vec2> v_all;
+    std::vector<glm::vec4> aabbs;
+    for (int layout = -1; layout <= QUADTREE_LAYOUT_VEB; layout++)
+    {
+        std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+        for (auto &v : vertices)
+            qt->insert(qt, v);
+        if (layout >= 0)
+            qt->compact(qt, (QuadtreeLayout)layout);
+
+        BenchTimer t0;
+        counter.start();
+        v_all.clear();
+        aabbs.clear();
+        qt->getVertices(qt, v_all);
+        qt->getAABBs(qt, aabbs);
+        uint64_t misses_full = counter.stop();
+        float ms_full = t0.getDeltaTimeMs();
+
+        BenchTimer t1;
+        counter.start();
+        for (size_t i = 0; i < n; i++)
+        {
+            v_BH.clear();
+            qt->approxBH(qt, vertices[i * stride], v_BH);
+        }
+        uint64_t misses_BH = counter.stop();
+        float ms_BH = t1.getDeltaTimeMs();
+
+        if (counter.valid())
+            printf("    %-8s: getVertices+getAABBs %.3fms (%llu cache misses), approxBH %.3fus/query "
+                   "(%.1f cache misses/query)\n", names[layout + 1], ms_full,
+                   (unsigned long long)misses_full, 1000.0f * ms_BH / n, (double)misses_BH / n);
+        else
+            printf("    %-8s: getVertices+getAABBs %.3fms, approxBH %.3fus/query\n",
+                   names[layout + 1], ms_full, 1000.0f * ms_BH / n);
+    }
+    if (!counter.valid())
+        printf("    (cache-miss counter unavailable, perf_event_open() failed)\n");
+}
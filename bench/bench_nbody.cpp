@@ -0,0 +1,27 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "src/nbody.h"
+
+
+//---------------------------------------------------------------------------------------
+// Fixed-step run from benchVertices() at rest, in steps per second and per-phase time
+BENCH(bench_nbody)
+{
+    std::vector<glm::vec2> positions = benchVertices();
+
+    NBodyParams params;
+    params.mass = 1.0f / (float)positions.size();
+    NBodySimulation sim(positions, std::vector<glm::vec2>(), params);
+
+    const size_t steps = 10;
+    BenchTimer t;
+    sim.run(steps);
+    float ms = t.getDeltaTimeMs();
+
+    const NBodyTimings &timings = sim.getTimings();
+    printf("    %zu bodies, %zu steps in %.3fms (%.2f steps/s)\n", positions.size(), steps, ms,
+           1000.0f * steps / ms);
+    printf("    per step: build %.3fms, force %.3fms, integrate %.3fms\n", timings.build / steps,
+           timings.force / steps, timings.integrate / steps);
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <random>
+
+#include "bench.h"
+
+
+//---------------------------------------------------------------------------------------
+// OctreeBH (OrthtreeBH<3>) on benchVertexCount() normally distributed vertices: build by
+// single and batch inserts, and accelerationBH() per query
+BENCH(bench_orthtree)
+{
+    size_t n = benchVertexCount();
+    std::mt19937 gen{ 1 };
+    std::normal_distribution<float> norm{ 0.0f, 0.25f };
+    std::vector<glm::vec3> vertices(n);
+    for (auto &v : vertices)
+        v = glm::clamp(glm::vec3(norm(gen), norm(gen), norm(gen)), -1.0f, 1.0f);
+
+    BenchTimer t0;
+    std::shared_ptr<OctreeBH> single = std::make_shared<OctreeBH>(n, AABB3());
+    for (auto &v : vertices)
+        single->insert(single, v);
+    float ms_single = t0.getDeltaTimeMs();
+
+    BenchTimer t1;
+    std::shared_ptr<OctreeBH> oc = std::make_shared<OctreeBH>(n, AABB3());
+    oc->insert(oc, vertices.data(), vertices.size());
+    float ms_batch = t1.getDeltaTimeMs();
+
+    size_t n_queries = 0;
+    glm::vec3 a = glm::vec3(0.0f);
+    BenchTimer t2;
+    for (size_t i = 0; i < n; i += 100, n_queries++)
+        a += oc->accelerationBH(oc, vertices[i], s_thetaBH, 0.01f);
+    float ms_BH = t2.getDeltaTimeMs();
+
+    printf("    %zu nodes, depth %u; build %.3fms (single inserts), %.3fms (batch)\n",
+           oc->nodeCount(oc), oc->depth(oc), ms_single, ms_batch);
+    printf("    accelerationBH (theta = %g): %.3fus/query (checksum %g)\n", s_thetaBH,
+           1000.0f * ms_BH / n_queries, glm::length(a));
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+
+static size_t s_vertexCount = 1000000;
+
+//---------------------------------------------------------------------------------------
+std::vector<BenchCase> &benchCases()
+{
+    static std::vector<BenchCase> cases;
+    return cases;
+}
+
+//---------------------------------------------------------------------------------------
+size_t benchVertexCount()
+{
+    return s_vertexCount;
+}
+
+//---------------------------------------------------------------------------------------
+// Runs all benchmarks (or those whose name contains argv[1]) on argv[2] vertices
+// (default 1M).
+int main(int _argc, char **_argv)
+{
+    if (_argc > 2)
+        s_vertexCount = std::max(strtoull(_argv[2], NULL, 10), 1000ull);
+
+    for (auto &bench : benchCases())
+    {
+        if (_argc > 1 && strcmp(_argv[1], "all") != 0 && strstr(bench.name, _argv[1]) == NULL)
+            continue;
+
+        printf("%s (%zu vertices)\n", bench.name, s_vertexCount);
+        bench.fnc();
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -94,3 +94,107 @@ project "quadtree"
     filter { "configurations.Release" }
         runtime "Release"
 
+
+
+-----------------------------------------------------------------------------------------
+-- headless checks of the tree and the algorithms built on it (everything in src/ but the
+-- application and the renderer); the exit code is non-zero if any test failed
+project "quadtree_tests"
+
+    kind "ConsoleApp"
+
+    targetdir ("%{wks.location}")
+	objdir ("%{wks.location}/obj/tests")
+
+    files
+    {
+        "tests/**.cpp",
+        "tests/**.h",
+        "src/**.cpp",
+        "src/**.h",
+    }
+
+    removefiles
+    {
+        "src/main.cpp",
+        "src/bh_renderer.cpp",
+        "src/bh_renderer.h",
+    }
+
+    includedirs
+    {
+        ".",
+        "/usr/include/synapse",
+    }
+
+    links
+    {
+        "glfw3",
+        "glad",
+        "assimp",
+        "freetype",
+        "pthread",
+        "dl",
+        "X11",
+        "atomic",
+        "synapse",
+    }
+
+    filter { "configurations.Debug" }
+        runtime "Debug"
+
+    filter { "configurations.Release" }
+        runtime "Release"
+
+
+
+-----------------------------------------------------------------------------------------
+-- headless timings of the tree and the algorithms built on it, on the vertex
+-- distribution of the application: quadtree_bench [name filter | all] [vertex count]
+project "quadtree_bench"
+
+    kind "ConsoleApp"
+
+    targetdir ("%{wks.location}")
+	objdir ("%{wks.location}/obj/bench")
+
+    files
+    {
+        "bench/**.cpp",
+        "bench/**.h",
+        "tests/test.h",
+        "src/**.cpp",
+        "src/**.h",
+    }
+
+    removefiles
+    {
+        "src/main.cpp",
+        "src/bh_renderer.cpp",
+        "src/bh_renderer.h",
+    }
+
+    includedirs
+    {
+        ".",
+        "/usr/include/synapse",
+    }
+
+    links
+    {
+        "glfw3",
+        "glad",
+        "assimp",
+        "freetype",
+        "pthread",
+        "dl",
+        "X11",
+        "atomic",
+        "synapse",
+    }
+
+    filter { "configurations.Debug" }
+        runtime "Debug"
+
+    filter { "configurations.Release" }
+        runtime "Release"
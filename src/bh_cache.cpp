@@ -0,0 +1,175 @@
+
+#include "bh_cache.h"
+
+
+//---------------------------------------------------------------------------------------
+const std::vector<glm::vec3> &BHInteractionCache::approxBH(QuadtreeBH *_qt, 
+                                                           const glm::vec2 &_cmp_vertex)
+{
+    m_changed = false;
+    uint64_t version = _qt->getVersion();
+
+    // node pointers in the cut are only valid as long as no nodes were moved in memory
+    bool same_query = (_qt == m_qt && 
+                       _cmp_vertex == m_cmpVertex && 
+                       s_thetaBH == m_theta &&
+                       _qt->m_tree->relocations == m_relocations);
+    
+    // nothing relevant changed
+    if (same_query && version == m_version)
+    {
+        m_hitCount++;
+        return m_output;
+    }
+
+    // same query, but a few vertices were inserted since: repair along their paths if
+    // they are still in the insert log of the tree
+    uint64_t n_inserted = version - m_version;
+    if (same_query && 
+        m_version >= _qt->m_tree->insertLogVersion && 
+        n_inserted <= m_maxRepair)
+    {
+        const std::vector<glm::vec2> &log = _qt->m_tree->insertLog;
+        size_t offset = m_version - _qt->m_tree->insertLogVersion;
+        for (size_t i = offset; i < log.size(); i++)
+            repair(_qt, log[i]);
+        m_repairCount++;
+    }
+    else
+    {
+        m_qt = _qt;
+        m_cmpVertex = _cmp_vertex;
+        m_theta = s_thetaBH;
+        rebuild(_qt);
+        m_rebuildCount++;
+    }
+    
+    m_version = version;
+    m_relocations = _qt->m_tree->relocations;
+    updateOutput();
+    m_changed = true;
+
+    return m_output;
+}
+
+//---------------------------------------------------------------------------------------
+void BHInteractionCache::rebuild(QuadtreeBH *_qt)
+{
+    m_cut.clear();
+    m_cutIndex.clear();
+    collect(_qt);
+}
+
+//---------------------------------------------------------------------------------------
+void BHInteractionCache::repair(QuadtreeBH *_qt, const glm::vec2 &_v)
+{
+    // Only the nodes on the path of _v have new aggregates, and thus only their opening
+    // decisions may have changed. Walk down the path until the decision of a node 
+    // differs from (or determines) the cut.
+    QuadtreeBH *node = _qt;
+    while (node != NULL)
+    {
+        // part of the cut (far or near leaf) -- re-evaluate the subtree from here
+        if (m_cutIndex.count(node))
+        {
+            removeCutNode(node);
+            collect(node);
+            return;
+        }
+
+        // previously opened (or previously empty) node
+        if (!node->isCloseBH(m_cmpVertex))
+        {
+            // now far enough to be approximated as a whole
+            removeCutSubtree(node);
+            addCutNode(node);
+            return;
+        }
+        else if (node->m_children == NULL)
+        {
+            // a previously empty leaf
+            addCutNode(node);
+            return;
+        }
+
+        node = node->getChild(node->getChildIndex(node, _v));
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void BHInteractionCache::collect(QuadtreeBH *_qt)
+{
+    // same traversal as QuadtreeBH::approxBH(), but storing the nodes
+    QuadtreeTraversal t(_qt);
+    while (QuadtreeBH *node = t.next())
+    {
+        if (!node->m_vertexCount)
+            continue;
+
+        if (node->isCloseBH(m_cmpVertex) && node->m_children != NULL)
+            t.open(node);
+        else
+            addCutNode(node);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void BHInteractionCache::addCutNode(QuadtreeBH *_qt)
+{
+    m_cutIndex[_qt] = m_cut.size();
+    m_cut.push_back(_qt);
+}
+
+//---------------------------------------------------------------------------------------
+void BHInteractionCache::removeCutNode(QuadtreeBH *_qt)
+{
+    auto it = m_cutIndex.find(_qt);
+    if (it == m_cutIndex.end())
+        return;
+
+    // swap with last
+    size_t idx = it->second;
+    m_cutIndex.erase(it);
+    if (idx != m_cut.size() - 1)
+    {
+        m_cut[idx] = m_cut.back();
+        m_cutIndex[m_cut[idx]] = idx;
+    }
+    m_cut.pop_back();
+}
+
+//---------------------------------------------------------------------------------------
+void BHInteractionCache::removeCutSubtree(QuadtreeBH *_qt)
+{
+    // nodes of a subtree are the ones with AABBs inside the AABB of its root
+    AABB2 aabb = _qt->getAABB();
+    for (size_t i = 0; i < m_cut.size(); )
+    {
+        if (aabb.contains(m_cut[i]->getAABB()))
+            removeCutNode(m_cut[i]);
+        else
+            i++;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void BHInteractionCache::updateOutput()
+{
+    m_output.clear();
+    for (auto node : m_cut)
+    {
+        // near leaf -- all vertices are relevant
+        if (node->m_children == NULL && !node->isAggregate() && node->isCloseBH(m_cmpVertex))
+        {
+            for (auto &v : node->getLocalVertices())
+                m_output.push_back(glm::vec3(v.x, v.y, 1.0f));
+        }
+        // far node
+        else
+        {
+            glm::vec2 mean = node->getMean();
+            m_output.push_back(glm::vec3(mean.x, mean.y, (float)node->m_vertexCount));
+        }
+    }
+}
+
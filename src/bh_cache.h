@@ -0,0 +1,87 @@
+#ifndef __BH_CACHE_H
+#define __BH_CACHE_H
+
+
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+
+#define BH_CACHE_MAX_REPAIR     64  // more inserts than this triggers a full rebuild
+
+
+/* Frame-coherent cache of the Barnes-Hut interaction list of a single query vertex.
+ * The list is keyed on (query vertex, s_thetaBH, tree version): when none of them 
+ * changed the previous list is returned as is. When only a few vertices were inserted
+ * since the list was built, only the parts of the tree on the paths of the new vertices
+ * are re-evaluated.
+ *
+ * Internally the list is stored as the 'cut' through the tree produced by approxBH(),
+ * i.e. the nodes approximated by their mean (far) and the leaves whose vertices are
+ * used directly (near). The output list is regenerated from the cut after a repair.
+ */
+class BHInteractionCache
+{
+public:
+    BHInteractionCache(size_t _max_repair=BH_CACHE_MAX_REPAIR) :
+        m_maxRepair(_max_repair)
+    {}
+    ~BHInteractionCache() = default;
+
+    // Same interaction list as QuadtreeBH::approxBH() (though not in the same order), but
+    // reusing the previous result when possible.
+    const std::vector<glm::vec3> &approxBH(QuadtreeBH *_qt, const glm::vec2 &_cmp_vertex);
+
+    __attribute__((always_inline))
+    const std::vector<glm::vec3> &approxBH(std::shared_ptr<QuadtreeBH> _qt, 
+                                           const glm::vec2 &_cmp_vertex)
+    { return approxBH(_qt.get(), _cmp_vertex); }
+
+    // Force a full rebuild on the next query (e.g. if the tree was destroyed).
+    void invalidate() { m_qt = NULL; }
+
+    // Accessors ------------------------------------------------------------------------
+    // true if the last call to approxBH() changed the interaction list
+    bool changed() { return m_changed; }
+    size_t getHitCount() { return m_hitCount; }
+    size_t getRepairCount() { return m_repairCount; }
+    size_t getRebuildCount() { return m_rebuildCount; }
+
+
+private:
+    void rebuild(QuadtreeBH *_qt);
+    void repair(QuadtreeBH *_qt, const glm::vec2 &_v);
+    void collect(QuadtreeBH *_qt);
+    void addCutNode(QuadtreeBH *_qt);
+    void removeCutNode(QuadtreeBH *_qt);
+    void removeCutSubtree(QuadtreeBH *_qt);
+    void updateOutput();
+
+
+private:
+    // key
+    QuadtreeBH *m_qt = NULL;
+    glm::vec2 m_cmpVertex = glm::vec2(0.0f);
+    float m_theta = 0.0f;
+    uint64_t m_version = 0;
+    uint64_t m_relocations = 0;
+
+    // the cut through the tree and its index in m_cut
+    std::vector<QuadtreeBH *> m_cut;
+    std::unordered_map<QuadtreeBH *, size_t> m_cutIndex;
+
+    // interaction list, as given by QuadtreeBH::approxBH()
+    std::vector<glm::vec3> m_output;
+
+    size_t m_maxRepair;
+    bool m_changed = false;
+    size_t m_hitCount = 0;
+    size_t m_repairCount = 0;
+    size_t m_rebuildCount = 0;
+
+};
+
+
+
+#endif // __BH_CACHE_H
@@ -11,6 +11,7 @@ BHRenderer::BHRenderer(std::shared_ptr<QuadtreeBH> &_qt)
     //
     m_shader = ShaderLibrary::load("../assets/shaders/quadtree.glsl");
     m_BHshader = ShaderLibrary::load("../assets/shaders/BH_node_shader.glsl");
+    m_aabbShader = ShaderLibrary::load("../assets/shaders/aabb_instanced.glsl");
     
     //
     m_qt = _qt;
@@ -50,16 +51,23 @@ void BHRenderer::initializeGeometry()
 
     // vertices of tree data
     m_verticesVBO = API::newVertexBuffer(GL_DYNAMIC_DRAW);
-    m_verticesVBO->setData(/*vertices.data()*/NULL, sizeof(glm::vec2) * m_qt->m_maxVertices);
+    m_verticesVBO->setData(/*vertices.data()*/NULL, sizeof(glm::vec2) * m_qt->getMaxVertices());
     m_verticesVBO->setBufferLayout(default_layout);
     m_verticesVAO = API::newVertexArray(m_verticesVBO);
+    m_verticesStaging.resize(m_qt->getMaxVertices());
     
-    // lines for AABBs
-    m_maxAABBCount = 8 * m_qt->m_maxVertices;
+    // AABBs as instanced vec4:s (grown in updateGeometry() if needed)
+    m_maxAABBCount = m_qt->getMaxVertices();
+    m_aabbStaging.resize(m_maxAABBCount);
     m_aabbVBO = API::newVertexBuffer(GL_DYNAMIC_DRAW);
-    m_aabbVBO->setData(/*aabbs.data()*/ NULL, sizeof(glm::vec2) * m_maxAABBCount);
-    m_aabbVBO->setBufferLayout(default_layout);
+    m_aabbVBO->setData(/*aabbs.data()*/ NULL, sizeof(glm::vec4) * m_maxAABBCount);
+    m_aabbVBO->setBufferLayout({{ VERTEX_ATTRIB_LOCATION_POSITION, 
+                                  ShaderDataType::Float4, 
+                                  "a_aabb" }});
     m_aabbVAO = API::newVertexArray(m_aabbVBO);
+    m_aabbVAO->bind();
+    glVertexAttribDivisor(VERTEX_ATTRIB_LOCATION_POSITION, 1);
+    m_aabbVAO->unbind();
 
     // prepare AABB highlight
     m_highlightAABB_VBO = API::newVertexBuffer(GL_DYNAMIC_DRAW);
@@ -75,7 +83,7 @@ void BHRenderer::initializeGeometry()
 
     // prepare for BH vertices, dimensioning VBO size
     m_BH_verticesVBO = API::newVertexBuffer(GL_DYNAMIC_DRAW);
-    m_BH_verticesVBO->setData(NULL, sizeof(glm::vec3) * m_qt->m_maxVertices);
+    m_BH_verticesVBO->setData(NULL, sizeof(glm::vec3) * m_qt->getMaxVertices());
     m_BH_verticesVBO->setBufferLayout({
         { VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_position" },
     });
@@ -85,33 +93,97 @@ void BHRenderer::initializeGeometry()
     m_buffersInitialized = true;
 }
 
+//---------------------------------------------------------------------------------------
+void BHRenderer::setTree(std::shared_ptr<QuadtreeBH> &_qt)
+{
+    // buffers are dimensioned by the capacity of the tree
+    bool resize = !m_qt || m_qt->getMaxVertices() != _qt->getMaxVertices();
+    m_qt = _qt;
+    if (resize)
+        initializeGeometry();
+    
+    updateGeometry();
+}
+
 //---------------------------------------------------------------------------------------
 void BHRenderer::updateGeometry()
 {
+    updateGeometry(m_viewAABB);
+}
+
+//---------------------------------------------------------------------------------------
+void BHRenderer::updateGeometry(const AABB2 &_view)
+{
+    m_viewAABB = _view;
+    
+    // the full tree is visible when culling is disabled
+    AABB2 view = m_viewCulling ? _view : m_qt->getAABB();
+    // full refresh: sizes are known from the tree, and the staging buffers are filled in 
+    // parallel
+    bool full = view.contains(m_qt->getAABB());
+
     // vertices (data)
     if (m_verticesVAO != nullptr)
     {
-        // get vertices from tree
-        std::vector<glm::vec2> vertices;
-        m_qt->getVertices(m_qt, vertices);
-        m_vertexCount = vertices.size();
+        // get visible vertices from tree
+        m_vertexCount = 0;
+        if (full && m_qt->getVertexCount() <= m_verticesStaging.size())
+        {
+            m_qt->exportVertices(m_qt, m_verticesStaging.data());
+            m_vertexCount = m_qt->getVertexCount();
+        }
+        else
+            m_qt->getVertices(m_qt, view, m_verticesStaging.data(), m_verticesStaging.size(), m_vertexCount);
         
-        m_verticesVBO->updateBufferData(vertices.data(), sizeof(glm::vec2) * m_vertexCount, 0);
+        m_verticesVBO->updateBufferData(m_verticesStaging.data(), sizeof(glm::vec2) * m_vertexCount, 0);
     }
 
     // AABB
     if (m_aabbVAO != nullptr)
     {
-        // get aabbs from tree
-        std::vector<glm::vec2> aabbs;
-        m_qt->getAABBLines(m_qt, aabbs);
-        m_aabbCount = aabbs.size();
+        if (full)
+        {
+            m_aabbCount = m_qt->getLeafCount();
+            if (m_aabbCount > m_aabbStaging.size())
+                m_aabbStaging.resize(m_aabbCount);
+            m_qt->exportAABBs(m_qt, m_aabbStaging.data());
+        }
+        // get visible aabbs from tree, growing the buffers if they didn't fit
+        else
+        {
+            while (true)
+            {
+                m_aabbCount = 0;
+                m_qt->getAABBs(m_qt, view, m_aabbStaging.data(), m_aabbStaging.size(), m_aabbCount);
+                if (m_aabbCount < m_aabbStaging.size())
+                    break;
+                m_aabbStaging.resize(std::max<size_t>(2 * m_aabbStaging.size(), 1024));
+            }
+        }
+        if (m_aabbStaging.size() > m_maxAABBCount)
+        {
+            m_maxAABBCount = m_aabbStaging.size();
+            m_aabbVBO->setData(NULL, sizeof(glm::vec4) * m_maxAABBCount);
+        }
 
-        m_aabbVBO->updateBufferData(aabbs.data(), sizeof(glm::vec2) * m_aabbCount, 0);
+        m_aabbVBO->updateBufferData(m_aabbStaging.data(), sizeof(glm::vec4) * m_aabbCount, 0);
     }
 
 }
 
+//---------------------------------------------------------------------------------------
+AABB2 BHRenderer::getViewAABB(const Ref<OrthographicCamera> &_camera)
+{
+    // same transform as used for mouse picking, applied to the NDC corners
+    glm::mat4 inv_vp = glm::inverse(_camera->getViewProjectionMatrix());
+    glm::vec4 offset = glm::vec4(_camera->getPosition().x, _camera->getPosition().y, 0.0f, 0.0f);
+    glm::vec4 c0 = glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f) * inv_vp + offset;
+    glm::vec4 c1 = glm::vec4( 1.0f,  1.0f, 0.0f, 1.0f) * inv_vp + offset;
+
+    return AABB2(glm::vec2(std::min(c0.x, c1.x), std::min(c0.y, c1.y)),
+                 glm::vec2(std::max(c0.x, c1.x), std::max(c0.y, c1.y)));
+}
+
 //---------------------------------------------------------------------------------------
 void BHRenderer::render(const Ref<OrthographicCamera> &_camera)
 {
@@ -120,6 +192,11 @@ void BHRenderer::render(const Ref<OrthographicCamera> &_camera)
 
     static auto &renderer = Renderer::get();
 
+    // re-cull when the camera has moved or zoomed
+    AABB2 view = getViewAABB(_camera);
+    if (m_viewCulling && view != m_viewAABB)
+        updateGeometry(view);
+
     m_shader->enable();
     m_shader->setMatrix4fv("u_view_projection_matrix", _camera->getViewProjectionMatrix());
 
@@ -133,18 +210,16 @@ void BHRenderer::render(const Ref<OrthographicCamera> &_camera)
         renderer.drawArrays(m_highlightAABB_VAO, 8, 0, false, GL_TRIANGLES);
     }
 
-    // all AABBs
-    if (m_renderAABB)
+    // all AABBs, 8 line vertices per instance
+    if (m_renderAABB && m_aabbCount)
     {
-        if (m_aabbCount > m_maxAABBCount)
-        {
-            SYN_WARNING("m_aabbCount > m_maxAABBCount");
-        }
-        else
-        {
-            m_shader->setUniform4fv("u_color", { 0.7f, 0.7f, 0.7f, 1.0f });
-            renderer.drawArrays(m_aabbVAO, m_aabbCount, 0, false, GL_LINES);
-        }
+        m_aabbShader->enable();
+        m_aabbShader->setMatrix4fv("u_view_projection_matrix", _camera->getViewProjectionMatrix());
+        m_aabbShader->setUniform4fv("u_color", { 0.7f, 0.7f, 0.7f, 1.0f });
+        m_aabbVAO->bind();
+        glDrawArraysInstanced(GL_LINES, 0, 8, m_aabbCount);
+        m_aabbVAO->unbind();
+        m_shader->enable();
     }
 
 
@@ -212,12 +287,12 @@ void BHRenderer::highlightVertex(const glm::vec2 &_v)
 }
 
 //---------------------------------------------------------------------------------------
-void BHRenderer::highlightBH(std::vector<glm::vec3> &_bh_vertices)
+void BHRenderer::highlightBH(const std::vector<glm::vec3> &_bh_vertices)
 {
     if (m_BH_verticesVAO != nullptr)
     {
         m_BH_vertexCount = _bh_vertices.size();
-        m_BH_verticesVBO->updateBufferData(&(_bh_vertices)[0], 
+        m_BH_verticesVBO->updateBufferData(_bh_vertices.data(), 
                                            sizeof(glm::vec3) * m_BH_vertexCount,
                                            0);
     }
@@ -38,25 +38,34 @@ public:
     void viewportResizeCallback(Event *_e);
     void initializeGeometry();
     void updateGeometry();  // called after QuadtreeBH->insert():s    
+    void updateGeometry(const AABB2 &_view);  // only geometry visible in _view
     void render(const Ref<OrthographicCamera> &_camera);
+    // switch to another tree (e.g. a newer snapshot of an async build)
+    void setTree(Ref<QuadtreeBH> &_qt);
+
+    // visible region of the tree in world coordinates
+    static AABB2 getViewAABB(const Ref<OrthographicCamera> &_camera);
 
     // geometry update functions called from main
     void highlightAABB(const AABB2 &_aabb);
     void highlightVertex(const glm::vec2 &_v);
-    void highlightBH(std::vector<glm::vec3> &_bh_vertices);
+    void highlightBH(const std::vector<glm::vec3> &_bh_vertices);
 
     // accessors
     void toggleAABB() { m_renderAABB = !m_renderAABB; }
     void toggleRenderBH() { m_renderBH = !m_renderBH; }
     void toggleHighlightAABB() { m_renderHighlightAABB = !m_renderHighlightAABB; }
     void toggleHighlightVertex() { m_renderHighlightVertex = !m_renderHighlightVertex; }
+    void toggleViewCulling() { m_viewCulling = !m_viewCulling; updateGeometry(); }
 
     bool getRenderAABB() { return m_renderAABB; }
     bool getRenderBH() { return m_renderBH; }
     bool getRenderHighlightAABB() { return m_renderHighlightAABB; }
     bool getRenderHighlightVertex() { return m_renderHighlightVertex; }
+    bool getViewCulling() { return m_viewCulling; }
 
-    size_t getTotalVertexCount() { return m_vertexCount; }
+    size_t getTotalVertexCount() { return m_qt->m_vertexCount; }
+    size_t getVisibleVertexCount() { return m_vertexCount; }
     size_t getBHVertexCount() { return m_BH_vertexCount; }
 
 
@@ -67,18 +76,25 @@ private:
     Ref<QuadtreeBH> m_qt = nullptr;
     Ref<Shader> m_shader = nullptr;
     Ref<Shader> m_BHshader = nullptr;
+    Ref<Shader> m_aabbShader = nullptr;
 
     glm::ivec2 m_viewportSz = { 0, 0 };
 
     bool m_buffersInitialized = false;
     float m_defaultPointSize = 3.0f;
+
+    // view-frustum culling; only the geometry inside m_viewAABB is uploaded
+    bool m_viewCulling = true;
+    AABB2 m_viewAABB;
+    std::vector<glm::vec2> m_verticesStaging;
+    std::vector<glm::vec4> m_aabbStaging;
     
-    // 2d vertices (ie the data)
+    // 2d vertices (ie the data), m_vertexCount is the number of visible vertices
     size_t m_vertexCount = 0;
     Ref<VertexBuffer> m_verticesVBO;
     Ref<VertexArray> m_verticesVAO;
     
-    // tree AABBs
+    // tree AABBs, one vec4 (min, max) per leaf expanded to lines through instancing
     bool m_renderAABB = false;
     size_t m_maxAABBCount;
     size_t m_aabbCount = 0;
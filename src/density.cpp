@@ -0,0 +1,104 @@
+
+#include <atomic>
+#include <math.h>
+
+#include "density.h"
+#include "parallel.h"
+
+
+// Rasterizes the nodes overlapping one tile of the grid
+struct DensityVisitor : QuadtreeVisitor
+{
+    DensityVisitor(const AABB2 &_region, 
+                   uint32_t _width, 
+                   uint32_t _height, 
+                   uint32_t *_grid) :
+        origin(_region.v0),
+        upper(_region.v1),
+        invCell(_width / (_region.v1.x - _region.v0.x), _height / (_region.v1.y - _region.v0.y)),
+        width(_width), grid(_grid)
+    {}
+
+    // cell range [c0, c1] overlapped by a (half-open) node
+    void cells(const AABB2 &_aabb, glm::ivec2 &_c0, glm::ivec2 &_c1)
+    {
+        glm::vec2 v0 = (_aabb.v0 - origin) * invCell;
+        glm::vec2 v1 = (_aabb.v1 - origin) * invCell;
+        _c0 = glm::ivec2((int)floorf(v0.x), (int)floorf(v0.y));
+        _c1 = glm::ivec2((int)ceilf(v1.x) - 1, (int)ceilf(v1.y) - 1);
+    }
+
+    void deposit(const glm::vec2 &_v, uint32_t _count)
+    {
+        glm::vec2 c = (_v - origin) * invCell;
+        int x = (int)floorf(c.x);
+        int y = (int)floorf(c.y);
+        if (x >= tile0.x && x <= tile1.x && y >= tile0.y && y <= tile1.y)
+            grid[(size_t)y * width + x] += _count;
+    }
+
+    bool openNode(QuadtreeBH *_qt)
+    {
+        if (!_qt->getVertexCount())
+            return false;
+
+        AABB2 aabb = _qt->getAABB();
+        glm::ivec2 c0, c1;
+        cells(aabb, c0, c1);
+        if (c1.x < tile0.x || c0.x > tile1.x || c1.y < tile0.y || c0.y > tile1.y)
+            return false;
+
+        // inside a single cell (of this tile); vertices on the upper edges of the root 
+        // are kept in the last leaves, but are outside a region ending there
+        if (c0 == c1 && aabb.v1.x != upper.x && aabb.v1.y != upper.y)
+            grid[(size_t)c0.y * width + c0.x] += _qt->getVertexCount();
+        // only the aggregate is known
+        else if (_qt->isAggregate())
+            deposit(_qt->getMean(), _qt->getVertexCount());
+        else
+            return true;
+
+        return false;
+    }
+
+    void visitPoint(const glm::vec2 &_v) { deposit(_v, 1); }
+
+    glm::vec2 origin;
+    glm::vec2 upper;
+    glm::vec2 invCell;
+    uint32_t width;
+    uint32_t *grid;
+    glm::ivec2 tile0, tile1;    // inclusive cell range of the current tile
+};
+
+//---------------------------------------------------------------------------------------
+void rasterizeDensity(QuadtreeBH *_qt, 
+                      const AABB2 &_region, 
+                      uint32_t _width, 
+                      uint32_t _height, 
+                      std::vector<uint32_t> &_out_density)
+{
+    _out_density.assign((size_t)_width * _height, 0);
+    if (!_width || !_height)
+        return;
+
+    // tiles own disjoint cells, and are handed out dynamically (the density is uneven)
+    uint32_t tiles_x = (_width + DENSITY_TILE_SIZE - 1) / DENSITY_TILE_SIZE;
+    uint32_t tiles_y = (_height + DENSITY_TILE_SIZE - 1) / DENSITY_TILE_SIZE;
+    size_t n_tiles = (size_t)tiles_x * tiles_y;
+    std::atomic<size_t> next = { 0 };
+    parallel_for(std::min(n_tiles, parallel_thread_count()), [&](size_t, size_t, size_t)
+    {
+        DensityVisitor visitor(_region, _width, _height, _out_density.data());
+        size_t t;
+        while ((t = next++) < n_tiles)
+        {
+            glm::ivec2 tile((int)(t % tiles_x), (int)(t / tiles_x));
+            visitor.tile0 = tile * DENSITY_TILE_SIZE;
+            visitor.tile1 = glm::min(visitor.tile0 + DENSITY_TILE_SIZE, 
+                                     glm::ivec2(_width, _height)) - 1;
+            _qt->traverse(_qt, visitor);
+        }
+    }, 1);
+}
+
@@ -0,0 +1,41 @@
+#ifndef __DENSITY_H
+#define __DENSITY_H
+
+
+#include <vector>
+#include <stdint.h>
+
+#include "quadtree.h"
+
+
+// square tiles of grid cells, the unit of work of rasterizeDensity()
+#define DENSITY_TILE_SIZE 64
+
+
+/* Density grid of the vertices of _qt inside _region: _out_density (resized to 
+ * _width * _height, row-major, row 0 at _region.v0.y) holds the number of vertices in 
+ * each cell. Cells are half-open, like AABB2::contains() (vertices on a cell edge may
+ * end up in the neighbouring cell through rounding).
+ *
+ * The tree is only descended until a node falls inside a single cell, whose vertex 
+ * count is then deposited as a whole, so the cost is bounded by the grid resolution 
+ * rather than the number of vertices. Tiles are rasterized in parallel; no GL context 
+ * is needed.
+ */
+void rasterizeDensity(QuadtreeBH *_qt, 
+                      const AABB2 &_region, 
+                      uint32_t _width, 
+                      uint32_t _height, 
+                      std::vector<uint32_t> &_out_density);
+
+__attribute__((always_inline))
+inline void rasterizeDensity(std::shared_ptr<QuadtreeBH> _qt, 
+                             const AABB2 &_region, 
+                             uint32_t _width, 
+                             uint32_t _height, 
+                             std::vector<uint32_t> &_out_density)
+{ rasterizeDensity(_qt.get(), _region, _width, _height, _out_density); }
+
+
+
+#endif // __DENSITY_H
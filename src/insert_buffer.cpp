@@ -0,0 +1,75 @@
+
+#include "insert_buffer.h"
+
+
+//---------------------------------------------------------------------------------------
+QuadtreeInsertBuffer::QuadtreeInsertBuffer(const std::shared_ptr<QuadtreeBH> &_qt,
+                                           size_t _capacity,
+                                           double _max_delay_ms) :
+    m_qt(_qt), m_capacity(_capacity), m_maxDelay(_max_delay_ms)
+{
+    m_vertices.reserve(_capacity);
+}
+
+//---------------------------------------------------------------------------------------
+void QuadtreeInsertBuffer::push(const glm::vec2 &_v)
+{
+    push(&_v, 1);
+}
+
+//---------------------------------------------------------------------------------------
+void QuadtreeInsertBuffer::push(const glm::vec2 *_v, size_t _count)
+{
+    if (!_count)
+        return;
+
+    if (m_vertices.empty())
+        m_oldest = std::chrono::high_resolution_clock::now();
+    m_vertices.insert(m_vertices.end(), _v, _v + _count);
+
+    if (m_vertices.size() >= m_capacity)
+        flush();
+}
+
+//---------------------------------------------------------------------------------------
+bool QuadtreeInsertBuffer::poll()
+{
+    if (m_vertices.empty())
+        return false;
+
+    double age = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_oldest).count();
+    if (age < m_maxDelay)
+        return false;
+
+    flush();
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+size_t QuadtreeInsertBuffer::flush()
+{
+    size_t count = m_vertices.size();
+    if (!count || m_qt == nullptr)
+        return 0;
+
+    m_qt->insert(m_qt, m_vertices.data(), count);
+    m_vertices.clear();
+    m_flushCount++;
+
+    // one notification for the whole batch
+    for (auto &listener : m_listeners)
+        listener(m_qt.get(), count);
+
+    return count;
+}
+
+//---------------------------------------------------------------------------------------
+void QuadtreeInsertBuffer::setTree(const std::shared_ptr<QuadtreeBH> &_qt)
+{
+    if (_qt == m_qt)
+        return;
+
+    flush();
+    m_qt = _qt;
+}
+
@@ -0,0 +1,73 @@
+#ifndef __INSERT_BUFFER_H
+#define __INSERT_BUFFER_H
+
+
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+
+#define INSERT_BUFFER_CAPACITY      4096    // buffered vertices that trigger a flush
+#define INSERT_BUFFER_MAX_DELAY     50.0    // (ms) age of the oldest buffered vertex that triggers a flush
+
+
+/* Buffer for vertices produced a few at a time (interactively or streamed), inserted
+ * into the tree in batches (see QuadtreeBH::insert(_qt, _v, _count)): the vertices are
+ * sorted by location code and merged in one pass, instead of walking the tree (and
+ * splitting leaves) once per vertex.
+ *
+ * The buffer is flushed explicitly, when it holds _capacity vertices, or on poll() once
+ * the oldest buffered vertex is older than _max_delay_ms. Each flush notifies the
+ * listeners once, e.g. to update the geometry of a BHRenderer. Buffered vertices are
+ * not visible to queries on the tree until flushed.
+ */
+class QuadtreeInsertBuffer
+{
+public:
+    // called after each flush with the tree and the number of vertices inserted
+    typedef std::function<void(QuadtreeBH *_qt, size_t _count)> Listener;
+
+public:
+    QuadtreeInsertBuffer(const std::shared_ptr<QuadtreeBH> &_qt,
+                         size_t _capacity=INSERT_BUFFER_CAPACITY,
+                         double _max_delay_ms=INSERT_BUFFER_MAX_DELAY);
+    ~QuadtreeInsertBuffer() = default;
+
+    void push(const glm::vec2 &_v);
+    void push(const glm::vec2 *_v, size_t _count);
+    // flushes if the oldest buffered vertex is older than the maximum delay, returns
+    // true if it did; call once per frame
+    bool poll();
+    // inserts all buffered vertices, returns their number
+    size_t flush();
+
+    // switch to another tree (e.g. a newer snapshot of an async build), flushing the
+    // buffered vertices into the current tree first
+    void setTree(const std::shared_ptr<QuadtreeBH> &_qt);
+    void addListener(const Listener &_listener) { m_listeners.push_back(_listener); }
+
+    // Accessors ------------------------------------------------------------------------
+    size_t size() { return m_vertices.size(); }
+    size_t getCapacity() { return m_capacity; }
+    double getMaxDelay() { return m_maxDelay; }
+    size_t getFlushCount() { return m_flushCount; }
+
+
+private:
+    std::shared_ptr<QuadtreeBH> m_qt;
+    std::vector<glm::vec2> m_vertices;
+    std::vector<Listener> m_listeners;
+
+    size_t m_capacity;
+    double m_maxDelay;
+    // time of the first push since the last flush
+    std::chrono::high_resolution_clock::time_point m_oldest;
+    size_t m_flushCount = 0;
+
+};
+
+
+
+#endif // __INSERT_BUFFER_H
@@ -4,6 +4,9 @@
 
 #include "quadtree.h"
 #include "bh_renderer.h"
+#include "bh_cache.h"
+#include "quadtree_builder.h"
+#include "insert_buffer.h"
 
 
 using namespace Syn;
@@ -25,6 +28,8 @@ public:
     void __debug_setup_rnorm();
     void __debug_setup_empty();
     void __debug_setup_BH_test();
+    void __debug_setup_async();
+    void __debug_poll_async();
     //
     void __debug_update_tf_point();
     //
@@ -43,6 +48,13 @@ public:
     Ref<QuadtreeBH> m_qt;
     Ref<BHRenderer> m_renderer;
     Ref<OrthographicCamera> m_camera;
+    BHInteractionCache m_bhCache;
+    // background build, publishing snapshots to m_qt
+    Ref<QuadtreeAsyncBuild> m_build = nullptr;
+    uint32_t m_buildGeneration = 0;
+    bool m_depthStale = false;
+    // interactive inserts, merged into m_qt in batches
+    Ref<QuadtreeInsertBuffer> m_insertBuffer = nullptr;
 
     // DEBUG : input
     glm::vec4 m_tf_point;
@@ -133,9 +145,67 @@ void layer::__debug_setup_BH_test()
         
     }
     SYN_TRACE("tree created in ", t.getDeltaTimeMs(), "ms.");
+    size_t node_count = m_qt->nodeCount(m_qt);
+    SYN_TRACE("  ", node_count, " nodes, ", (float)m_qt->memoryUsage(m_qt) / (float)node_count, " bytes/node.");
 
 }
 
+//----------------------------------------------------------------------------------------
+void layer::__debug_setup_async()
+{
+    // same distribution as __debug_setup_BH_test(), but N vertices, built in the background
+    std::random_device rd{};
+    std::mt19937 gen{rd()};
+    std::normal_distribution<float> norm{ 0.0f, 0.05f };
+    std::uniform_real_distribution<float> uniform{ -0.9f, 0.9f };
+
+    std::vector<glm::vec2> vertices;
+    vertices.reserve(N);
+    int n_groupings = 1000;
+    int n_per_group = N / n_groupings;
+    for (int i = 0; i < n_groupings; i++)
+    {
+        glm::vec2 mpos = glm::vec2(uniform(gen), uniform(gen));
+        for (int i = 0; i < n_per_group; i++)
+        {
+            glm::vec2 p = glm::vec2(norm(gen), norm(gen)) + mpos;
+            p.x = clamp(p.x, -1.0f, 1.0f);
+            p.y = clamp(p.y, -1.0f, 1.0f);
+            vertices.push_back(p);
+        }
+    }
+
+    // empty tree until the first snapshot arrives
+    m_qt = std::make_shared<QuadtreeBH>(N);
+    m_build = std::make_shared<QuadtreeAsyncBuild>(std::move(vertices), N);
+}
+
+//----------------------------------------------------------------------------------------
+void layer::__debug_poll_async()
+{
+    if (m_build == nullptr)
+        return;
+
+    uint32_t generation = m_build->getGeneration();
+    if (generation != m_buildGeneration)
+    {
+        m_buildGeneration = generation;
+        m_qt = m_build->getSnapshot();
+        m_insertBuffer->setTree(m_qt);
+        m_renderer->setTree(m_qt);
+        m_bhCache.invalidate();
+        m_selQT = NULL;
+        m_depthStale = true;
+    }
+
+    if (m_build->isDone() && m_buildGeneration == m_build->getGeneration())
+    {
+        SYN_TRACE("async build: coarse tree after ", m_build->getCoarseTime(), "ms, full tree after ", 
+                  m_build->getFullTime(), "ms.");
+        m_build = nullptr;
+    }
+}
+
 //----------------------------------------------------------------------------------------
 void layer::onAttach()
 {
@@ -155,10 +225,21 @@ void layer::onAttach()
     // generate tree
     // __debug_setup_rnorm();
     // __debug_setup_empty();
-    __debug_setup_BH_test();
+    // __debug_setup_BH_test();
+    __debug_setup_async();
 
     // Initialize QuadtreeBH renderer (BHRenderer)
     m_renderer = std::make_shared<BHRenderer>(m_qt);
+
+    // one geometry update per batch of inserts
+    m_insertBuffer = std::make_shared<QuadtreeInsertBuffer>(m_qt);
+    m_insertBuffer->addListener([this](QuadtreeBH *_qt, size_t _count)
+    {
+        m_renderer->updateGeometry();
+        m_depthStale = true;
+        // inserts reallocate packed children
+        m_selQT = NULL;
+    });
     
     // Initialize camera
     m_camera = API::newOrthographicCamera(1.0f, 50.0f);
@@ -218,9 +299,10 @@ void layer::__debug_tree_interaction()
         if (m_renderer->getRenderHighlightVertex() && m_sel_vertex != glm::vec2(0.0f))
             cmp_vertex = m_sel_vertex;
 
-        std::vector<glm::vec3> v_BH;
-        m_qt->approxBH(m_qt, cmp_vertex, v_BH);
-        m_renderer->highlightBH(v_BH);
+        // only re-uploaded when the query, theta or the tree changed
+        const std::vector<glm::vec3> &v_BH = m_bhCache.approxBH(m_qt, cmp_vertex);
+        if (m_bhCache.changed())
+            m_renderer->highlightBH(v_BH);
     }
 
 }
@@ -228,6 +310,10 @@ void layer::__debug_tree_interaction()
 //----------------------------------------------------------------------------------------
 void layer::__debug_insert_on_rclick()
 {
+    // snapshots of a running background build are read-only
+    if (m_build != nullptr)
+        return;
+
     glm::vec2 mpos = { m_tf_point.x, m_tf_point.y };
 
     std::random_device rd{};
@@ -239,11 +325,9 @@ void layer::__debug_insert_on_rclick()
         glm::vec2 p = glm::vec2(norm(gen), norm(gen)) + mpos;
         p.x = clamp(p.x, -1.0f, 1.0f);
         p.y = clamp(p.y, -1.0f, 1.0f);
-        m_qt->insert(m_qt, p);
+        m_insertBuffer->push(p);
     }
 
-    m_renderer->updateGeometry();
-
 }
 
 //----------------------------------------------------------------------------------------
@@ -261,6 +345,10 @@ void layer::onUpdate(float _dt)
 
     // -- BEGINNING OF SCENE -- //
 
+    // pick up new snapshots of the tree
+    __debug_poll_async();
+    m_insertBuffer->poll();
+
     // update mouse position relative to camera and tree
     __debug_update_tf_point();
 
@@ -282,6 +370,11 @@ void layer::onUpdate(float _dt)
     static float fontHeight = m_font->getFontHeight() + 1.0f;
     int i = 0;
     static int depth = m_qt->depth(m_qt);
+    if (m_depthStale)
+    {
+        depth = m_qt->depth(m_qt);
+        m_depthStale = false;
+    }
     //
     m_font->beginRenderBlock();
 	m_font->addString(2.0f, fontHeight * ++i, "fps=%.0f  VSYNC=%s", TimeStep::getFPS(), Application::get().getWindow().isVSYNCenabled() ? "ON" : "OFF");
@@ -291,10 +384,11 @@ void layer::onUpdate(float _dt)
         m_renderer->getRenderBH() ? "true " : "false",
         m_renderer->getRenderHighlightAABB() ? "true " : "false",
         m_renderer->getRenderHighlightVertex() ? "true " : "false");
+    m_font->addString(2.0f, fontHeight * ++i, "view culling[F6] %s", m_renderer->getViewCulling() ? "true " : "false");
     m_font->addString(2.0f, fontHeight * ++i, "sel vcount = %zu, sel level = %d", m_selQT_pointCount, m_selQT_level);
     size_t vcount = m_renderer->getTotalVertexCount();
     size_t bh_vcount = m_renderer->getBHVertexCount();
-    m_font->addString(2.0f, fontHeight * ++i, "total vertices = %zu", vcount);
+    m_font->addString(2.0f, fontHeight * ++i, "total vertices = %zu (%zu visible)", vcount, m_renderer->getVisibleVertexCount());
     m_font->addString(2.0f, fontHeight * ++i, "BH vertices    = %zu (%.2f%%)", bh_vcount, 100.0f * (float)bh_vcount / (float)vcount);
     m_font->addString(2.0f, fontHeight * ++i, "theta = %.2f", s_thetaBH);
     m_font->endRenderBlock();
@@ -331,6 +425,7 @@ void layer::onKeyDownEvent(Event *_e)
                 m_toggleCulling = !m_toggleCulling;
                 Renderer::setCulling(m_toggleCulling);
                 break;
+            case SYN_KEY_F6:        m_renderer->toggleViewCulling();        break;
             default: break;
         }
     }
@@ -0,0 +1,150 @@
+
+#include <chrono>
+#include <synapse/Debug>
+
+#include "nbody.h"
+#include "parallel.h"
+
+
+//
+static inline double elapsed_ms(const std::chrono::high_resolution_clock::time_point &_t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _t0).count();
+}
+
+//---------------------------------------------------------------------------------------
+NBodySimulation::NBodySimulation(const std::vector<glm::vec2> &_positions,
+                                 const std::vector<glm::vec2> &_velocities,
+                                 const NBodyParams &_params) :
+    m_params(_params), 
+    m_positions(_positions), 
+    m_velocities(_velocities)
+{
+    m_velocities.resize(m_positions.size(), glm::vec2(0.0f));
+    m_accelerations.resize(m_positions.size(), glm::vec2(0.0f));
+
+    // initial accelerations
+    buildTree();
+    computeForces();
+}
+
+//---------------------------------------------------------------------------------------
+NBodySimulation::~NBodySimulation()
+{
+    if (m_destroyed.valid())
+        m_destroyed.wait();
+}
+
+//---------------------------------------------------------------------------------------
+void NBodySimulation::step()
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+    float h = 0.5f * m_params.dt;
+
+    auto t = std::chrono::high_resolution_clock::now();
+    kick(h);
+    drift(m_params.dt);
+    m_timings.integrate += elapsed_ms(t);
+
+    t = std::chrono::high_resolution_clock::now();
+    buildTree();
+    m_timings.build += elapsed_ms(t);
+
+    t = std::chrono::high_resolution_clock::now();
+    computeForces();
+    m_timings.force += elapsed_ms(t);
+
+    t = std::chrono::high_resolution_clock::now();
+    kick(h);
+    m_timings.integrate += elapsed_ms(t);
+
+    m_timings.total += elapsed_ms(t0);
+    m_timings.steps++;
+}
+
+//---------------------------------------------------------------------------------------
+void NBodySimulation::run(size_t _steps)
+{
+    for (size_t i = 0; i < _steps; i++)
+        step();
+}
+
+//---------------------------------------------------------------------------------------
+void NBodySimulation::buildTree()
+{
+    // square bounds of all bodies, padded so that the upper bound is inside the root
+    size_t n_threads = parallel_thread_count();
+    std::vector<glm::vec2> mins(n_threads, glm::vec2(1e30f)), maxs(n_threads, glm::vec2(-1e30f));
+    parallel_for(m_positions.size(), [&](size_t _begin, size_t _end, size_t _thread)
+    {
+        glm::vec2 lo(1e30f), hi(-1e30f);
+        for (size_t i = _begin; i < _end; i++)
+        {
+            lo = glm::min(lo, m_positions[i]);
+            hi = glm::max(hi, m_positions[i]);
+        }
+        mins[_thread] = lo;
+        maxs[_thread] = hi;
+    });
+    glm::vec2 lo(1e30f), hi(-1e30f);
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        lo = glm::min(lo, mins[i]);
+        hi = glm::max(hi, maxs[i]);
+    }
+    glm::vec2 c = (lo + hi) * 0.5f;
+    float r = 0.5f * std::max(hi.x - lo.x, hi.y - lo.y) * 1.001f + 1e-6f;
+
+    // the previous tree is destroyed in the background while the new one is built
+    if (m_destroyed.valid())
+        m_destroyed.wait();
+    if (m_qt != nullptr)
+    {
+        std::shared_ptr<QuadtreeBH> prev = std::move(m_qt);
+        m_destroyed = std::async(std::launch::async, [prev]() mutable { prev.reset(); });
+    }
+
+    // (batch insert, keyed, sorted and merged in parallel for large batches)
+    m_qt = std::make_shared<QuadtreeBH>(m_positions.size(), AABB2(c - glm::vec2(r), c + glm::vec2(r)));
+    m_qt->insert(m_qt.get(), m_positions.data(), m_positions.size());
+}
+
+//---------------------------------------------------------------------------------------
+void NBodySimulation::computeForces()
+{
+    QuadtreeBH *qt = m_qt.get();
+    parallel_for(m_positions.size(), [&](size_t _begin, size_t _end, size_t)
+    {
+        BHOpening opening(m_params.criterion, m_params.theta, m_params.alpha);
+        for (size_t i = _begin; i < _end; i++)
+        {
+            // previous acceleration, per unit mass as returned by accelerationBH()
+            opening.accel = glm::length(m_accelerations[i]) / m_params.mass;
+            m_accelerations[i] = m_params.mass * qt->accelerationBH(qt, 
+                                                                    m_positions[i], 
+                                                                    opening, 
+                                                                    m_params.softening);
+        }
+    });
+}
+
+//---------------------------------------------------------------------------------------
+void NBodySimulation::kick(float _dt)
+{
+    parallel_for(m_positions.size(), [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+            m_velocities[i] += m_accelerations[i] * _dt;
+    });
+}
+
+//---------------------------------------------------------------------------------------
+void NBodySimulation::drift(float _dt)
+{
+    parallel_for(m_positions.size(), [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+            m_positions[i] += m_velocities[i] * _dt;
+    });
+}
+
@@ -0,0 +1,89 @@
+#ifndef __NBODY_H
+#define __NBODY_H
+
+
+#include <vector>
+#include <future>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+
+
+//
+struct NBodyParams
+{
+    float dt = 1e-3f;
+    float theta = 0.5f;         // Barnes-Hut opening angle (see QuadtreeBH::isCloseBH())
+    // Opening criterion; BH_CRITERION_RELATIVE uses the accelerations of the previous 
+    // step (and theta for the very first force evaluation)
+    BHCriterion criterion = BH_CRITERION_GEOMETRIC;
+    float alpha = 0.005f;       // tolerance of BH_CRITERION_RELATIVE
+    float softening = 1e-3f;    // Plummer softening length
+    float mass = 1e-6f;         // mass of every body (times G)
+};
+
+// Accumulated wall-clock time (ms) per phase of the simulation
+struct NBodyTimings
+{
+    double build = 0.0;         // tree rebuild (including computing the bounds)
+    double force = 0.0;         // Barnes-Hut accelerations
+    double integrate = 0.0;     // kick and drift
+    double total = 0.0;
+    size_t steps = 0;
+};
+
+
+/* N-body time integration on top of QuadtreeBH, using kick-drift-kick leapfrog (i.e.
+ * velocity Verlet) with Plummer-softened gravity:
+ *
+ *  v += a(x) * dt/2;  x += v * dt;  <rebuild tree>;  a = a(x);  v += a(x) * dt/2
+ *
+ * Kick/drift and the force evaluation run in parallel over the bodies, and the tree is
+ * rebuilt by a batch insert of all bodies (keyed, sorted and merged in parallel, see 
+ * QuadtreeBH::insert()). The force evaluation of a step depends on the tree of the same 
+ * step, so the two can't overlap; instead the tree of the previous step is destroyed on
+ * a background thread while the next one is built.
+ */
+class NBodySimulation
+{
+public:
+    NBodySimulation(const std::vector<glm::vec2> &_positions,
+                    const std::vector<glm::vec2> &_velocities,
+                    const NBodyParams &_params=NBodyParams());
+    ~NBodySimulation();
+
+    void step();
+    void run(size_t _steps);
+
+    // Accessors ------------------------------------------------------------------------
+    const std::vector<glm::vec2> &getPositions() { return m_positions; }
+    const std::vector<glm::vec2> &getVelocities() { return m_velocities; }
+    const NBodyTimings &getTimings() { return m_timings; }
+    std::shared_ptr<QuadtreeBH> &getTree() { return m_qt; }
+    NBodyParams &getParams() { return m_params; }
+
+
+private:
+    void buildTree();
+    void computeForces();
+    void kick(float _dt);
+    void drift(float _dt);
+
+
+private:
+    NBodyParams m_params;
+    std::vector<glm::vec2> m_positions;
+    std::vector<glm::vec2> m_velocities;
+    std::vector<glm::vec2> m_accelerations;
+
+    std::shared_ptr<QuadtreeBH> m_qt = nullptr;
+    std::future<void> m_destroyed;  // destruction of the previous tree
+
+    NBodyTimings m_timings;
+
+};
+
+
+
+#endif // __NBODY_H
@@ -0,0 +1,214 @@
+
+#include <atomic>
+#include <string.h>
+
+#include "neighbours.h"
+#include "parallel.h"
+
+
+// A subtree with the index of its first vertex (in depth-first order)
+struct NodeRange
+{
+    QuadtreeBH *node;
+    uint32_t first;
+};
+
+// Output of one task, for the vertices [first, first + counts.size())
+struct NeighbourTask
+{
+    NodeRange range;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> indices;
+};
+
+//
+static inline float aabbDistance2(const AABB2 &_a, const AABB2 &_b)
+{
+    float dx = std::max(std::max(_a.v0.x - _b.v1.x, _b.v0.x - _a.v1.x), 0.0f);
+    float dy = std::max(std::max(_a.v0.y - _b.v1.y, _b.v0.y - _a.v1.y), 0.0f);
+    return dx * dx + dy * dy;
+}
+
+//
+static inline float pointDistance2(const glm::vec2 &_v, const AABB2 &_b)
+{
+    float dx = std::max(std::max(_b.v0.x - _v.x, _v.x - _b.v1.x), 0.0f);
+    float dy = std::max(std::max(_b.v0.y - _v.y, _v.y - _b.v1.y), 0.0f);
+    return dx * dx + dy * dy;
+}
+
+/* Candidates of a query node are kept on one stack (_cands) per task: the candidates of
+ * a child are pushed on top of those of its parent, and popped when the child is done.
+ * Recursion is bounded by MAX_DEPTH.
+ */
+static void selfJoin(const NodeRange &_query, 
+                     std::vector<NodeRange> &_cands, 
+                     size_t _cand_begin, 
+                     float _r2, 
+                     NeighbourTask &_task)
+{
+    QuadtreeBH *q = _query.node;
+    AABB2 q_aabb = q->getAABB();
+    uint32_t q_level = q->getLevel();
+    size_t begin = _cands.size();
+
+    // Refine the parent's candidates: drop those too far away and replace candidates 
+    // that aren't smaller than the query node by their children; at a query leaf, 
+    // expand all the way down to leaves.
+    bool q_leaf = q->isLeaf();
+    for (size_t i = _cand_begin; i < begin; i++)
+    {
+        NodeRange c = _cands[i];
+        if (aabbDistance2(q_aabb, c.node->getAABB()) > _r2)
+            continue;
+        if (!c.node->isLeaf() && (q_leaf || c.node->getLevel() <= q_level))
+        {
+            // expand (breadth-first, through the growing tail of the stack)
+            size_t k = _cands.size();
+            _cands.push_back(c);
+            while (k < _cands.size())
+            {
+                NodeRange e = _cands[k];
+                if (aabbDistance2(q_aabb, e.node->getAABB()) > _r2)
+                {
+                    _cands[k] = _cands.back();
+                    _cands.pop_back();
+                    continue;
+                }
+                if (!e.node->isLeaf() && (q_leaf || e.node->getLevel() <= q_level))
+                {
+                    // replace by children
+                    QuadtreeBH *children = e.node->getChildren();
+                    uint32_t first = e.first;
+                    _cands[k] = { &children[0], first };
+                    first += children[0].getVertexCount();
+                    for (int n = 1; n < e.node->getChildCount(); n++)
+                    {
+                        _cands.push_back({ &children[n], first });
+                        first += children[n].getVertexCount();
+                    }
+                    continue;
+                }
+                k++;
+            }
+        }
+        else
+            _cands.push_back(c);
+    }
+
+    if (!q_leaf)
+    {
+        QuadtreeBH *children = q->getChildren();
+        uint32_t first = _query.first;
+        for (int n = 0; n < q->getChildCount(); n++)
+        {
+            selfJoin({ &children[n], first }, _cands, begin, _r2, _task);
+            first += children[n].getVertexCount();
+        }
+    }
+    else
+    {
+        // brute force against the candidate leaves
+        uint32_t i = _query.first;
+        for (auto &v : q->getLocalVertices())
+        {
+            uint32_t count = 0;
+            for (size_t c = begin; c < _cands.size(); c++)
+            {
+                QuadtreeBH *leaf = _cands[c].node;
+                if (pointDistance2(v, leaf->getAABB()) > _r2)
+                    continue;
+                uint32_t j = _cands[c].first;
+                for (auto &w : leaf->getLocalVertices())
+                {
+                    glm::vec2 d = w - v;
+                    if (j != i && d.x * d.x + d.y * d.y <= _r2)
+                    {
+                        _task.indices.push_back(j);
+                        count++;
+                    }
+                    j++;
+                }
+            }
+            _task.counts[i - _task.range.first] = count;
+            i++;
+        }
+    }
+
+    _cands.resize(begin);
+}
+
+//---------------------------------------------------------------------------------------
+void fixedRadiusNeighbours(QuadtreeBH *_qt, float _radius, NeighbourLists &_out)
+{
+    size_t n = _qt->getVertexCount();
+    _out.offsets.assign(n + 1, 0);
+    _out.indices.clear();
+    if (!n)
+        return;
+
+    // tasks: subtrees of at most 'grain' vertices, in depth-first order
+    size_t grain = std::max(n / (16 * parallel_thread_count()), (size_t)256);
+    std::vector<NeighbourTask> tasks;
+    std::vector<NodeRange> stack = { { _qt, 0 } };
+    while (!stack.empty())
+    {
+        NodeRange r = stack.back();
+        stack.pop_back();
+        if (r.node->isLeaf() || r.node->getVertexCount() <= grain)
+        {
+            tasks.push_back(NeighbourTask());
+            tasks.back().range = r;
+            continue;
+        }
+        // push in reverse, to pop in order
+        QuadtreeBH *children = r.node->getChildren();
+        uint32_t first = r.first + r.node->getVertexCount();
+        for (int i = r.node->getChildCount() - 1; i >= 0; i--)
+        {
+            first -= children[i].getVertexCount();
+            stack.push_back({ &children[i], first });
+        }
+    }
+
+    // run the tasks, handed out dynamically
+    float r2 = _radius * _radius;
+    std::atomic<size_t> next = { 0 };
+    parallel_for(parallel_thread_count(), [&](size_t, size_t, size_t)
+    {
+        std::vector<NodeRange> cands;
+        size_t t;
+        while ((t = next++) < tasks.size())
+        {
+            NeighbourTask &task = tasks[t];
+            task.counts.resize(task.range.node->getVertexCount());
+            cands.assign(1, { _qt, 0 });
+            selfJoin(task.range, cands, 0, r2, task);
+        }
+    }, 1);
+
+    // merge: the tasks cover consecutive vertex ranges
+    std::vector<size_t> task_offsets(tasks.size() + 1, 0);
+    for (size_t t = 0; t < tasks.size(); t++)
+        task_offsets[t + 1] = task_offsets[t] + tasks[t].indices.size();
+    _out.indices.resize(task_offsets.back());
+    parallel_for(tasks.size(), [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t t = _begin; t < _end; t++)
+        {
+            NeighbourTask &task = tasks[t];
+            uint64_t offset = task_offsets[t];
+            for (size_t i = 0; i < task.counts.size(); i++)
+            {
+                _out.offsets[task.range.first + i] = offset;
+                offset += task.counts[i];
+            }
+            if (!task.indices.empty())
+                memcpy(_out.indices.data() + task_offsets[t], 
+                       task.indices.data(), 
+                       sizeof(uint32_t) * task.indices.size());
+        }
+    }, 1);
+    _out.offsets[n] = _out.indices.size();
+}
+
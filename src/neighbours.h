@@ -0,0 +1,39 @@
+#ifndef __NEIGHBOURS_H
+#define __NEIGHBOURS_H
+
+
+#include <vector>
+#include <stdint.h>
+
+#include "quadtree.h"
+
+
+// Neighbour lists in CSR form: the neighbours of vertex i are 
+// indices[offsets[i] .. offsets[i + 1]), where vertices are numbered in the order of
+// QuadtreeBH::getVertices(). Offsets are 64-bit: large self-joins exceed 2^32 pairs
+// (vertex indices fit in 32 bits, as the vertex count of a tree).
+struct NeighbourLists
+{
+    std::vector<uint64_t> offsets;  // vertex count + 1
+    std::vector<uint32_t> indices;
+};
+
+
+/* All-pairs fixed-radius neighbours (tree self-join): for every vertex, all other 
+ * vertices within _radius (inclusive).
+ *
+ * The tree is split into subtrees (contiguous ranges of vertices in depth-first order),
+ * processed in parallel. Within a subtree, the candidate nodes within _radius of a node 
+ * (by AABB distance) are refined from the candidates of its parent, so that neighbouring
+ * vertices share the traversal. Every task writes its own part of the output, and the 
+ * parts are concatenated in order, without locks.
+ */
+void fixedRadiusNeighbours(QuadtreeBH *_qt, float _radius, NeighbourLists &_out);
+
+__attribute__((always_inline))
+inline void fixedRadiusNeighbours(std::shared_ptr<QuadtreeBH> _qt, float _radius, NeighbourLists &_out)
+{ fixedRadiusNeighbours(_qt.get(), _radius, _out); }
+
+
+
+#endif // __NEIGHBOURS_H
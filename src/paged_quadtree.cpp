@@ -0,0 +1,693 @@
+
+#include <algorithm>
+#include <queue>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <synapse/Debug>
+
+#include "paged_quadtree.h"
+
+
+// File layout: header (page 0), pages (from page 1), resident nodes, page references
+struct PagedFileHeader
+{
+    char magic[4];
+    uint32_t pageSize;
+    glm::vec2 aabbMin;
+    glm::vec2 aabbMax;
+    uint64_t vertexCount;
+    uint32_t pageCount;
+    uint32_t nodeCount;
+    uint32_t refCount;
+    uint32_t pad;
+    uint64_t nodesOffset;
+};
+
+static const char s_pagedMagic[4] = { 'P', 'Q', 'T', '1' };
+
+// Vertex with its location code at MAX_DEPTH, the sort key of the build
+struct SortedVertex
+{
+    uint32_t key;
+    glm::vec2 v;
+    bool operator<(const SortedVertex &_other) const { return key < _other.key; }
+};
+
+// Splits the (sorted) vertices [_begin, _end) of node _key into the ranges of its
+// children: child i holds [_out_bounds[i], _out_bounds[i + 1])
+static void childRanges(const SortedVertex *_v,
+                        size_t _begin,
+                        size_t _end,
+                        uint32_t _key,
+                        size_t _out_bounds[5])
+{
+    uint32_t shift = 2 * (MAX_DEPTH - QuadtreeIndex::level(_key) - 1);
+    _out_bounds[0] = _begin;
+    _out_bounds[4] = _end;
+    for (uint8_t i = 1; i < 4; i++)
+    {
+        SortedVertex bound = { QuadtreeIndex::childKey(_key, i) << shift, glm::vec2(0.0f) };
+        _out_bounds[i] = std::lower_bound(_v + _out_bounds[i - 1], _v + _end, bound) - _v;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Writes the pages and the resident top of the tree during build()
+struct PagedWriter
+{
+    FILE *file;
+    size_t pageSize;
+    const SortedVertex *vertices;
+
+    std::vector<uint8_t> page;  // page being filled
+    size_t pageUsed = 0;
+    uint32_t pageIndex = 1;     // (page 0 is the header)
+
+    std::vector<PagedNode> nodes;
+    std::vector<PagedRef> refs;
+
+    // scratch for serializing subtrees
+    std::vector<PagedNode> blobNodes;
+    std::vector<glm::vec2> blobVertices;
+    std::vector<uint8_t> blob;
+
+    //
+    bool isLeaf(size_t _begin, size_t _end, uint32_t _key)
+    { return _end - _begin <= MAX_VERTICES_PER_NODE || QuadtreeIndex::level(_key) == MAX_DEPTH; }
+
+    // subtree of [_begin, _end) into blobNodes[_index] and below
+    void serialize(size_t _begin, size_t _end, uint32_t _key, uint32_t _index)
+    {
+        PagedNode node = { glm::vec2(0.0f), (uint32_t)(_end - _begin), _key, 0, 0, 0 };
+        if (isLeaf(_begin, _end, _key))
+        {
+            node.first = (uint32_t)blobVertices.size();
+            node.flags = PAGED_NODE_LEAF;
+            for (size_t i = _begin; i < _end; i++)
+            {
+                blobVertices.push_back(vertices[i].v);
+                node.total += vertices[i].v;
+            }
+            blobNodes[_index] = node;
+            return;
+        }
+
+        size_t bounds[5];
+        childRanges(vertices, _begin, _end, _key, bounds);
+        node.first = (uint32_t)blobNodes.size();
+        for (int i = 0; i < 4; i++)
+            node.childCount += (bounds[i] != bounds[i + 1]);
+        blobNodes.resize(blobNodes.size() + node.childCount);
+        for (uint8_t i = 0, k = 0; i < 4; i++)
+        {
+            if (bounds[i] == bounds[i + 1])
+                continue;
+            serialize(bounds[i], bounds[i + 1], QuadtreeIndex::childKey(_key, i), node.first + k);
+            node.total += blobNodes[node.first + k].total;
+            k++;
+        }
+        blobNodes[_index] = node;
+    }
+
+    //
+    void flushPage()
+    {
+        if (!pageUsed)
+            return;
+        memset(page.data() + pageUsed, 0, pageSize - pageUsed);
+        fwrite(page.data(), 1, pageSize, file);
+        pageIndex++;
+        pageUsed = 0;
+    }
+
+    // appends the serialized subtree to the pages (in order), returning its reference
+    uint32_t writeBlob()
+    {
+        uint32_t header[2] = { (uint32_t)blobNodes.size(), (uint32_t)blobVertices.size() };
+        size_t bytes = sizeof(header) +
+                       sizeof(PagedNode) * blobNodes.size() +
+                       sizeof(glm::vec2) * blobVertices.size();
+        blob.resize(bytes);
+        memcpy(blob.data(), header, sizeof(header));
+        memcpy(blob.data() + sizeof(header), blobNodes.data(), sizeof(PagedNode) * blobNodes.size());
+        memcpy(blob.data() + sizeof(header) + sizeof(PagedNode) * blobNodes.size(),
+               blobVertices.data(),
+               sizeof(glm::vec2) * blobVertices.size());
+
+        PagedRef ref;
+        if (bytes <= pageSize)
+        {
+            // pack into the current page (8-byte aligned)
+            pageUsed = (pageUsed + 7) & ~(size_t)7;
+            if (pageUsed + bytes > pageSize)
+                flushPage();
+            memcpy(page.data() + pageUsed, blob.data(), bytes);
+            ref = { pageIndex, 1, (uint32_t)pageUsed };
+            pageUsed += bytes;
+        }
+        else
+        {
+            // a run of whole pages
+            flushPage();
+            uint32_t n = (uint32_t)((bytes + pageSize - 1) / pageSize);
+            blob.resize(n * pageSize, 0);
+            fwrite(blob.data(), 1, blob.size(), file);
+            ref = { pageIndex, n, 0 };
+            pageIndex += n;
+        }
+        refs.push_back(ref);
+        return (uint32_t)refs.size() - 1;
+    }
+
+    // Resident node nodes[_index] for [_begin, _end): subtrees that fit in a page (and
+    // leaves, whatever their size) are paged, all others stay resident.
+    void build(size_t _begin, size_t _end, uint32_t _key, uint32_t _index)
+    {
+        size_t capacity = (pageSize - 2 * sizeof(uint32_t)) / sizeof(glm::vec2);
+        bool leaf = isLeaf(_begin, _end, _key);
+        if (leaf || _end - _begin <= capacity)
+        {
+            blobNodes.assign(1, PagedNode());
+            blobVertices.clear();
+            serialize(_begin, _end, _key, 0);
+            size_t bytes = 2 * sizeof(uint32_t) +
+                           sizeof(PagedNode) * blobNodes.size() +
+                           sizeof(glm::vec2) * blobVertices.size();
+            if (leaf || bytes <= pageSize)
+            {
+                PagedNode node = blobNodes[0];
+                node.first = writeBlob();
+                node.childCount = 0;
+                node.flags = PAGED_NODE_SUBTREE;
+                nodes[_index] = node;
+                return;
+            }
+        }
+
+        size_t bounds[5];
+        childRanges(vertices, _begin, _end, _key, bounds);
+        PagedNode node = { glm::vec2(0.0f), (uint32_t)(_end - _begin), _key, (uint32_t)nodes.size(), 0, 0 };
+        for (int i = 0; i < 4; i++)
+            node.childCount += (bounds[i] != bounds[i + 1]);
+        nodes.resize(nodes.size() + node.childCount);
+        for (uint8_t i = 0, k = 0; i < 4; i++)
+        {
+            if (bounds[i] == bounds[i + 1])
+                continue;
+            build(bounds[i], bounds[i + 1], QuadtreeIndex::childKey(_key, i), node.first + k);
+            node.total += nodes[node.first + k].total;
+            k++;
+        }
+        nodes[_index] = node;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+// Merges the sorted runs into _out
+static bool mergeRuns(const std::vector<std::string> &_runs, FILE *_out)
+{
+    const size_t buffer_size = 1 << 16;
+    struct Run
+    {
+        FILE *file;
+        std::vector<SortedVertex> buffer;
+        size_t pos = 0;
+        size_t count = 0;
+        bool next()
+        {
+            if (++pos < count)
+                return true;
+            count = fread(buffer.data(), sizeof(SortedVertex), buffer.size(), file);
+            pos = 0;
+            return count > 0;
+        }
+    };
+
+    std::vector<Run> runs(_runs.size());
+    typedef std::pair<uint32_t, size_t> Head;   // key, run
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    bool ok = true;
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        runs[i].file = fopen(_runs[i].c_str(), "rb");
+        ok &= (runs[i].file != NULL);
+        if (!ok)
+            break;
+        runs[i].buffer.resize(buffer_size);
+        runs[i].pos = (size_t)-1;
+        if (runs[i].next())
+            heads.push({ runs[i].buffer[0].key, i });
+    }
+
+    std::vector<SortedVertex> out;
+    out.reserve(buffer_size);
+    while (ok && !heads.empty())
+    {
+        Run &run = runs[heads.top().second];
+        heads.pop();
+        out.push_back(run.buffer[run.pos]);
+        if (out.size() == buffer_size)
+        {
+            ok &= (fwrite(out.data(), sizeof(SortedVertex), out.size(), _out) == out.size());
+            out.clear();
+        }
+        if (run.next())
+            heads.push({ run.buffer[run.pos].key, (size_t)(&run - runs.data()) });
+    }
+    ok &= (fwrite(out.data(), sizeof(SortedVertex), out.size(), _out) == out.size());
+
+    for (auto &run : runs)
+        if (run.file != NULL)
+            fclose(run.file);
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------
+bool PagedQuadtree::build(const std::string &_path,
+                          const VertexSource &_source,
+                          const AABB2 &_aabb,
+                          const PagedBuildParams &_params)
+{
+    // 1. external sort by location code at MAX_DEPTH: sorted runs, then merged
+    std::string sorted_path = _path + ".sorted";
+    std::vector<std::string> runs;
+    std::vector<glm::vec2> chunk(_params.sortRun);
+    std::vector<SortedVertex> run;
+    run.reserve(_params.sortRun);
+    glm::vec2 scale = (float)(1u << MAX_DEPTH) / (_aabb.v1 - _aabb.v0);
+    int max_cell = (1 << MAX_DEPTH) - 1;
+    uint64_t vertex_count = 0;
+    bool ok = true;
+    while (size_t n = _source(chunk.data(), chunk.size()))
+    {
+        run.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            glm::vec2 c = (chunk[i] - _aabb.v0) * scale;
+            uint32_t x = (uint32_t)std::min(std::max((int)floorf(c.x), 0), max_cell);
+            uint32_t y = (uint32_t)std::min(std::max((int)floorf(c.y), 0), max_cell);
+            run.push_back({ QuadtreeIndex::levelKey(glm::uvec2(x, y), MAX_DEPTH), chunk[i] });
+        }
+        std::sort(run.begin(), run.end());
+
+        runs.push_back(_path + ".run" + std::to_string(runs.size()));
+        FILE *f = fopen(runs.back().c_str(), "wb");
+        ok &= (f != NULL && fwrite(run.data(), sizeof(SortedVertex), n, f) == n);
+        if (f != NULL)
+            fclose(f);
+        vertex_count += n;
+        if (!ok)
+            break;
+    }
+    chunk = std::vector<glm::vec2>();
+    run = std::vector<SortedVertex>();
+
+    if (ok && runs.size() == 1)
+        ok = (rename(runs[0].c_str(), sorted_path.c_str()) == 0);
+    else if (ok)
+    {
+        FILE *f = fopen(sorted_path.c_str(), "wb");
+        ok = (f != NULL && mergeRuns(runs, f));
+        if (f != NULL)
+            fclose(f);
+    }
+    for (auto &r : runs)
+        remove(r.c_str());
+    if (!ok)
+    {
+        SYN_WARNING("PagedQuadtree: sorting the vertices failed.");
+        remove(sorted_path.c_str());
+        return false;
+    }
+
+    // 2. pages and resident top, from the (memory-mapped) sorted vertices
+    const SortedVertex *vertices = NULL;
+    size_t mapped_bytes = vertex_count * sizeof(SortedVertex);
+    int sorted_fd = open(sorted_path.c_str(), O_RDONLY);
+    if (mapped_bytes)
+    {
+        void *p = sorted_fd >= 0 ? mmap(NULL, mapped_bytes, PROT_READ, MAP_PRIVATE, sorted_fd, 0) : MAP_FAILED;
+        if (p == MAP_FAILED)
+        {
+            SYN_WARNING("PagedQuadtree: failed to map ", sorted_path, ".");
+            if (sorted_fd >= 0)
+                close(sorted_fd);
+            remove(sorted_path.c_str());
+            return false;
+        }
+        // read front to back
+        madvise(p, mapped_bytes, MADV_SEQUENTIAL);
+        vertices = (const SortedVertex *)p;
+    }
+
+    FILE *file = fopen(_path.c_str(), "wb");
+    if (file == NULL)
+    {
+        SYN_WARNING("PagedQuadtree: failed to create ", _path, ".");
+        ok = false;
+    }
+    else
+    {
+        PagedWriter writer;
+        writer.file = file;
+        writer.pageSize = _params.pageSize;
+        writer.vertices = vertices;
+        writer.page.resize(_params.pageSize);
+
+        // header page, written last
+        std::vector<uint8_t> zero(_params.pageSize, 0);
+        fwrite(zero.data(), 1, zero.size(), file);
+
+        writer.nodes.resize(1);
+        if (vertex_count)
+            writer.build(0, vertex_count, 1, 0);
+        else
+            writer.nodes[0] = { glm::vec2(0.0f), 0, 1, 0, 0, 0 };
+        writer.flushPage();
+
+        PagedFileHeader header;
+        memcpy(header.magic, s_pagedMagic, sizeof(header.magic));
+        header.pageSize = (uint32_t)_params.pageSize;
+        header.aabbMin = _aabb.v0;
+        header.aabbMax = _aabb.v1;
+        header.vertexCount = vertex_count;
+        header.pageCount = writer.pageIndex - 1;
+        header.nodeCount = (uint32_t)writer.nodes.size();
+        header.refCount = (uint32_t)writer.refs.size();
+        header.pad = 0;
+        header.nodesOffset = (uint64_t)writer.pageIndex * _params.pageSize;
+        fwrite(writer.nodes.data(), sizeof(PagedNode), writer.nodes.size(), file);
+        fwrite(writer.refs.data(), sizeof(PagedRef), writer.refs.size(), file);
+        fseek(file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, file);
+        ok = (ferror(file) == 0);
+        fclose(file);
+    }
+
+    if (vertices != NULL)
+        munmap((void *)vertices, mapped_bytes);
+    if (sorted_fd >= 0)
+        close(sorted_fd);
+    remove(sorted_path.c_str());
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------
+PagedQuadtree::PagedQuadtree(const std::string &_path, size_t _cache_budget) :
+    m_cacheBudget(_cache_budget)
+{
+    m_fd = open(_path.c_str(), O_RDONLY);
+    PagedFileHeader header;
+    if (m_fd < 0 ||
+        pread(m_fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, s_pagedMagic, sizeof(header.magic)) != 0)
+    {
+        SYN_WARNING("PagedQuadtree: ", _path, " is not a paged tree.");
+        if (m_fd >= 0)
+            close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    m_aabb = AABB2(header.aabbMin, header.aabbMax);
+    m_vertexCount = header.vertexCount;
+    m_pageSize = header.pageSize;
+    m_pageCount = header.pageCount;
+    m_nodes.resize(header.nodeCount);
+    m_refs.resize(header.refCount);
+    size_t node_bytes = sizeof(PagedNode) * m_nodes.size();
+    size_t ref_bytes = sizeof(PagedRef) * m_refs.size();
+    if (pread(m_fd, m_nodes.data(), node_bytes, header.nodesOffset) != (ssize_t)node_bytes ||
+        pread(m_fd, m_refs.data(), ref_bytes, header.nodesOffset + node_bytes) != (ssize_t)ref_bytes)
+    {
+        SYN_WARNING("PagedQuadtree: ", _path, " is truncated.");
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+PagedQuadtree::~PagedQuadtree()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+//---------------------------------------------------------------------------------------
+const uint8_t *PagedQuadtree::fetch(uint32_t _ref)
+{
+    const PagedRef &ref = m_refs[_ref];
+    auto it = m_cache.find(ref.page);
+    if (it != m_cache.end())
+    {
+        m_stats.hits++;
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return m_lru.front().data.data() + ref.offset;
+    }
+
+    // (failed reads aren't cached, a later fetch retries)
+    m_stats.misses++;
+    std::vector<uint8_t> page(ref.pageCount * m_pageSize);
+    if (pread(m_fd, page.data(), page.size(), (off_t)ref.page * m_pageSize) != (ssize_t)page.size())
+    {
+        SYN_WARNING("PagedQuadtree: failed to read page ", ref.page, ".");
+        m_stats.readErrors++;
+        return NULL;
+    }
+    m_lru.push_front({ ref.page, std::move(page) });
+    std::vector<uint8_t> &data = m_lru.front().data;
+    m_cache[ref.page] = m_lru.begin();
+    m_stats.bytesRead += data.size();
+    m_stats.bytesCached += data.size();
+    evict();
+
+    return data.data() + ref.offset;
+}
+
+//---------------------------------------------------------------------------------------
+void PagedQuadtree::evict()
+{
+    // least recently used first, but never the page just fetched
+    while (m_stats.bytesCached > m_cacheBudget && m_lru.size() > 1)
+    {
+        m_stats.bytesCached -= m_lru.back().data.size();
+        m_stats.evictions++;
+        m_cache.erase(m_lru.back().page);
+        m_lru.pop_back();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+AABB2 PagedQuadtree::cellAABB(uint32_t _key)
+{
+    glm::uvec2 cell = QuadtreeIndex::cell(_key);
+    glm::vec2 size = (m_aabb.v1 - m_aabb.v0) * (1.0f / (float)(1u << QuadtreeIndex::level(_key)));
+    glm::vec2 v0 = m_aabb.v0 + glm::vec2(cell) * size;
+    return AABB2(v0, v0 + size);
+}
+
+//---------------------------------------------------------------------------------------
+/* Depth-first walk over the resident nodes and, through the cache, the paged subtrees.
+ * _visitor.openNode(node) decides whether to descend into a node (for subtrees, before
+ * their page is fetched); _visitor.visitVertices(vertices, n) is called for opened
+ * leaves. Aborts, returning false, if a page can't be read.
+ */
+template<typename V>
+bool PagedQuadtree::walk(V &_visitor)
+{
+    if (m_nodes.empty())
+        return true;
+
+    std::vector<uint32_t> resident = { 0 };
+    std::vector<uint32_t> paged;
+    while (!resident.empty())
+    {
+        const PagedNode &node = m_nodes[resident.back()];
+        resident.pop_back();
+        if (!node.count || !_visitor.openNode(node))
+            continue;
+
+        if (!(node.flags & PAGED_NODE_SUBTREE))
+        {
+            for (int i = node.childCount - 1; i >= 0; i--)
+                resident.push_back(node.first + i);
+            continue;
+        }
+
+        // paged subtree: the whole walk below stays in this page (no other fetch)
+        const uint8_t *blob = fetch(node.first);
+        if (blob == NULL)
+            return false;
+        const uint32_t *header = (const uint32_t *)blob;
+        const PagedNode *nodes = (const PagedNode *)(blob + 2 * sizeof(uint32_t));
+        const glm::vec2 *vertices = (const glm::vec2 *)(nodes + header[0]);
+
+        // (the root was opened above, through its resident copy)
+        paged.assign(1, 0);
+        bool root = true;
+        while (!paged.empty())
+        {
+            const PagedNode &n = nodes[paged.back()];
+            paged.pop_back();
+            if (!root && !_visitor.openNode(n))
+                continue;
+            root = false;
+
+            if (n.flags & PAGED_NODE_LEAF)
+                _visitor.visitVertices(vertices + n.first, n.count);
+            else
+                for (int i = n.childCount - 1; i >= 0; i--)
+                    paged.push_back(n.first + i);
+        }
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool PagedQuadtree::approxBH(const glm::vec2 &_cmp_vertex, std::vector<glm::vec3> &_out_v_bh)
+{
+    // same opening criterion as QuadtreeBH::isCloseBH()
+    struct Visitor
+    {
+        bool openNode(const PagedNode &_node)
+        {
+            float s = size * (1.0f / (float)(1u << QuadtreeIndex::level(_node.key)));
+            float c = (float)_node.count;
+            glm::vec2 d = _node.total - c * query;
+            if (s * s * c * c >= theta2 * (d.x * d.x + d.y * d.y))
+                return true;
+            glm::vec2 mean = _node.total / c;
+            out.push_back(glm::vec3(mean.x, mean.y, c));
+            return false;
+        }
+        void visitVertices(const glm::vec2 *_v, size_t _n)
+        {
+            for (size_t i = 0; i < _n; i++)
+                out.push_back(glm::vec3(_v[i].x, _v[i].y, 1.0f));
+        }
+        glm::vec2 query;
+        float size;
+        float theta2;
+        std::vector<glm::vec3> &out;
+    } visitor = { _cmp_vertex, m_aabb.v1.x - m_aabb.v0.x, s_thetaBH * s_thetaBH, _out_v_bh };
+    return walk(visitor);
+}
+
+//---------------------------------------------------------------------------------------
+bool PagedQuadtree::getVertices(const AABB2 &_region, std::vector<glm::vec2> &_out_points)
+{
+    struct Visitor
+    {
+        bool openNode(const PagedNode &_node) { return region.intersects(tree->cellAABB(_node.key)); }
+        void visitVertices(const glm::vec2 *_v, size_t _n)
+        {
+            for (size_t i = 0; i < _n; i++)
+                if (region.contains(_v[i]))
+                    out.push_back(_v[i]);
+        }
+        PagedQuadtree *tree;
+        AABB2 region;
+        std::vector<glm::vec2> &out;
+    } visitor = { this, _region, _out_points };
+    return walk(visitor);
+}
+
+//---------------------------------------------------------------------------------------
+bool PagedQuadtree::nearest(const glm::vec2 &_v, size_t _k, std::vector<glm::vec2> &_out_points)
+{
+    _out_points.clear();
+    if (!_k || m_nodes.empty())
+        return true;
+
+    // Best-first search: nodes by distance from _v to their cell, resident or paged
+    // (page reference and index in the page); the k best vertices so far in a max-heap.
+    struct Entry
+    {
+        float dist2;
+        uint32_t ref;       // (uint32_t)-1 for resident nodes
+        uint32_t index;
+        bool operator>(const Entry &_other) const { return dist2 > _other.dist2; }
+    };
+    typedef std::pair<float, glm::vec2> Candidate;
+    auto candidate_less = [](const Candidate &_a, const Candidate &_b) { return _a.first < _b.first; };
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    std::vector<Candidate> best;
+
+    auto dist2 = [&](uint32_t _key)
+    {
+        AABB2 aabb = cellAABB(_key);
+        glm::vec2 d = glm::max(glm::max(aabb.v0 - _v, _v - aabb.v1), glm::vec2(0.0f));
+        return d.x * d.x + d.y * d.y;
+    };
+    auto push_children = [&](const PagedNode *_nodes, const PagedNode &_node, uint32_t _ref)
+    {
+        for (uint32_t i = 0; i < _node.childCount; i++)
+            queue.push({ dist2(_nodes[_node.first + i].key), _ref, _node.first + i });
+    };
+
+    queue.push({ 0.0f, (uint32_t)-1, 0 });
+    while (!queue.empty())
+    {
+        Entry e = queue.top();
+        queue.pop();
+        if (best.size() == _k && e.dist2 > best.front().first)
+            break;
+
+        // resident node: descend, or continue at the root of its page
+        const PagedNode *nodes = m_nodes.data();
+        const glm::vec2 *vertices = NULL;
+        uint32_t ref = e.ref;
+        uint32_t index = e.index;
+        if (ref == (uint32_t)-1)
+        {
+            const PagedNode &node = m_nodes[index];
+            if (!(node.flags & PAGED_NODE_SUBTREE))
+            {
+                push_children(nodes, node, ref);
+                continue;
+            }
+            ref = node.first;
+            index = 0;
+        }
+        const uint8_t *blob = fetch(ref);
+        if (blob == NULL)
+            return false;
+        nodes = (const PagedNode *)(blob + 2 * sizeof(uint32_t));
+        vertices = (const glm::vec2 *)(nodes + ((const uint32_t *)blob)[0]);
+
+        const PagedNode &node = nodes[index];
+        if (!(node.flags & PAGED_NODE_LEAF))
+        {
+            push_children(nodes, node, ref);
+            continue;
+        }
+        for (uint32_t i = 0; i < node.count; i++)
+        {
+            glm::vec2 d = vertices[node.first + i] - _v;
+            float d2 = d.x * d.x + d.y * d.y;
+            if (best.size() < _k)
+            {
+                best.push_back({ d2, vertices[node.first + i] });
+                std::push_heap(best.begin(), best.end(), candidate_less);
+            }
+            else if (d2 < best.front().first)
+            {
+                std::pop_heap(best.begin(), best.end(), candidate_less);
+                best.back() = { d2, vertices[node.first + i] };
+                std::push_heap(best.begin(), best.end(), candidate_less);
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), candidate_less);
+    for (auto &c : best)
+        _out_points.push_back(c.second);
+    return true;
+}
+
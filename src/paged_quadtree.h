@@ -0,0 +1,149 @@
+#ifndef __PAGED_QUADTREE_H
+#define __PAGED_QUADTREE_H
+
+
+#include <vector>
+#include <list>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+
+#define PAGED_PAGE_SIZE     (64 * 1024)     // default page size (bytes)
+#define PAGED_SORT_RUN      (1 << 22)       // vertices sorted in memory per run of the build
+
+// PagedNode::flags
+#define PAGED_NODE_LEAF     1   // vertices [first, first + count)
+#define PAGED_NODE_SUBTREE  2   // (resident nodes only) subtree stored in page reference 'first'
+
+
+// Node of the resident top of a paged tree, or of a subtree stored in a page. Children
+// are contiguous, in quadrant order, as in QuadtreeBH.
+struct PagedNode
+{
+    glm::vec2 total;        // sum of the vertices (see QuadtreeBH::getMean())
+    uint32_t count;
+    uint32_t key;           // location code (see QuadtreeIndex)
+    uint32_t first;         // first child, first vertex or page reference (see flags)
+    uint16_t childCount;
+    uint16_t flags;
+};
+
+// Location of a subtree in the file: in page 'page' at byte 'offset', or spanning
+// 'pageCount' pages from the start of 'page' (subtrees larger than a page, i.e.
+// buckets of duplicates)
+struct PagedRef
+{
+    uint32_t page;
+    uint32_t pageCount;
+    uint32_t offset;
+};
+
+//
+struct PagedBuildParams
+{
+    size_t pageSize = PAGED_PAGE_SIZE;
+    size_t sortRun = PAGED_SORT_RUN;    // bounds the memory used by the build
+};
+
+//
+struct PagedCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t bytesRead = 0;
+    uint64_t readErrors = 0;    // failed page reads (not cached)
+    size_t bytesCached = 0;
+};
+
+
+/* Out-of-core quadtree for vertex sets larger than memory. The top levels of the tree
+ * are resident; the subtrees below them are stored in fixed-size pages of a file and
+ * read on demand through an LRU page cache, bounded by a memory budget. Pages are laid
+ * out in Morton order (the depth-first order of the tree), so that both the build and
+ * spatially coherent queries read the file sequentially.
+ *
+ * The file is written by build(), which streams the vertices from a callback and sorts
+ * them by location code externally (in runs of PagedBuildParams::sortRun vertices), so
+ * that the vertices never need to be in memory at once. The tree has the same shape as
+ * a QuadtreeBH (MAX_VERTICES_PER_NODE vertices per leaf, down to MAX_DEPTH), except that
+ * vertices are assigned to cells by quantization rather than by midpoint comparisons.
+ *
+ * Queries are not thread-safe (they share the page cache).
+ */
+class PagedQuadtree
+{
+public:
+    PagedQuadtree(const std::string &_path, size_t _cache_budget);
+    ~PagedQuadtree();
+
+    // Writes the paged tree of all vertices returned by _source to _path. _source fills
+    // its buffer with up to _max_count vertices and returns the count, 0 at the end.
+    typedef std::function<size_t(glm::vec2 *_buffer, size_t _max_count)> VertexSource;
+    static bool build(const std::string &_path,
+                      const VertexSource &_source,
+                      const AABB2 &_aabb,
+                      const PagedBuildParams &_params=PagedBuildParams());
+
+    // Queries, as on QuadtreeBH: Barnes-Hut approximation (see QuadtreeBH::approxBH()),
+    // the vertices inside _region and the _k nearest vertices to _v (closest first).
+    // Return false, with incomplete output, if a page couldn't be read.
+    bool approxBH(const glm::vec2 &_cmp_vertex, std::vector<glm::vec3> &_out_v_bh);
+    bool getVertices(const AABB2 &_region, std::vector<glm::vec2> &_out_points);
+    bool nearest(const glm::vec2 &_v, size_t _k, std::vector<glm::vec2> &_out_points);
+
+    // Accessors ------------------------------------------------------------------------
+    bool isOpen() { return m_fd >= 0; }
+    const AABB2 &getAABB() { return m_aabb; }
+    uint64_t getVertexCount() { return m_vertexCount; }
+    size_t getResidentNodeCount() { return m_nodes.size(); }
+    size_t getPageCount() { return m_pageCount; }
+    size_t getCacheBudget() { return m_cacheBudget; }
+    void setCacheBudget(size_t _bytes) { m_cacheBudget = _bytes; evict(); }
+    const PagedCacheStats &getCacheStats() { return m_stats; }
+    void resetCacheStats() { size_t cached = m_stats.bytesCached; m_stats = PagedCacheStats(); m_stats.bytesCached = cached; }
+
+
+private:
+    // Subtree in the cache: [uint32 node count][uint32 vertex count][PagedNode * nodes]
+    // [glm::vec2 * vertices]. Valid until the next fetch(); NULL if the page couldn't 
+    // be read.
+    const uint8_t *fetch(uint32_t _ref);
+    void evict();
+
+    AABB2 cellAABB(uint32_t _key);
+    template<typename V>
+    bool walk(V &_visitor);
+
+
+private:
+    int m_fd = -1;
+    AABB2 m_aabb;
+    uint64_t m_vertexCount = 0;
+    size_t m_pageSize = PAGED_PAGE_SIZE;
+    size_t m_pageCount = 0;
+
+    // resident top of the tree
+    std::vector<PagedNode> m_nodes;
+    std::vector<PagedRef> m_refs;
+
+    // LRU page cache (most recently used first), keyed by first page
+    struct CacheEntry
+    {
+        uint32_t page;
+        std::vector<uint8_t> data;
+    };
+    std::list<CacheEntry> m_lru;
+    std::unordered_map<uint32_t, std::list<CacheEntry>::iterator> m_cache;
+    size_t m_cacheBudget;
+    PagedCacheStats m_stats;
+
+};
+
+
+
+#endif // __PAGED_QUADTREE_H
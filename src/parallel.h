@@ -0,0 +1,89 @@
+#ifndef __PARALLEL_H
+#define __PARALLEL_H
+
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+
+// Number of worker threads used by parallel_for() (at least 1)
+inline size_t parallel_thread_count()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/* Splits [0, _n) into contiguous chunks, one per worker thread, and calls 
+ * _fnc(begin, end, thread_index) for each of them concurrently. Returns when all chunks
+ * are done. Ranges smaller than _min_chunk per thread use fewer threads (down to
+ * running on the calling thread only).
+ */
+template<typename F>
+void parallel_for(size_t _n, F &&_fnc, size_t _min_chunk=1024)
+{
+    size_t n_threads = std::min(parallel_thread_count(), 
+                                std::max((size_t)1, _n / std::max((size_t)1, _min_chunk)));
+    if (n_threads == 1)
+    {
+        _fnc((size_t)0, _n, (size_t)0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    size_t chunk = (_n + n_threads - 1) / n_threads;
+    for (size_t t = 1; t < n_threads; t++)
+    {
+        size_t begin = std::min(_n, t * chunk);
+        size_t end = std::min(_n, begin + chunk);
+        threads.emplace_back([&_fnc, begin, end, t]() { _fnc(begin, end, t); });
+    }
+    _fnc((size_t)0, std::min(_n, chunk), (size_t)0);
+
+    for (auto &thread : threads)
+        thread.join();
+}
+
+/* Sorts [_begin, _end): one chunk per worker thread is sorted concurrently, then the 
+ * sorted runs are merged pairwise, the merges of a round also concurrently. Ranges 
+ * smaller than _min_chunk per thread use fewer threads (as parallel_for()).
+ */
+template<typename It, typename Less>
+void parallel_sort(It _begin, It _end, Less _less, size_t _min_chunk=16384)
+{
+    size_t n = _end - _begin;
+    size_t n_chunks = std::min(parallel_thread_count(), 
+                               std::max((size_t)1, n / std::max((size_t)1, _min_chunk)));
+    if (n_chunks == 1)
+    {
+        std::sort(_begin, _end, _less);
+        return;
+    }
+
+    size_t chunk = (n + n_chunks - 1) / n_chunks;
+    parallel_for(n_chunks, [&](size_t _first, size_t _last, size_t)
+    {
+        for (size_t c = _first; c < _last; c++)
+            std::sort(_begin + std::min(n, c * chunk), 
+                      _begin + std::min(n, (c + 1) * chunk), 
+                      _less);
+    }, 1);
+
+    for (size_t width = chunk; width < n; width *= 2)
+    {
+        parallel_for((n + 2 * width - 1) / (2 * width), [&](size_t _first, size_t _last, size_t)
+        {
+            for (size_t m = _first; m < _last; m++)
+            {
+                size_t mid = std::min(n, (2 * m + 1) * width);
+                size_t end = std::min(n, (2 * m + 2) * width);
+                if (mid < end)
+                    std::inplace_merge(_begin + 2 * m * width, _begin + mid, _begin + end, _less);
+            }
+        }, 1);
+    }
+}
+
+
+
+#endif // __PARALLEL_H
@@ -0,0 +1,72 @@
+#ifndef __PERF_COUNTER_H
+#define __PERF_COUNTER_H
+
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+/* Hardware event counter for the calling thread through perf_event_open() (Linux only),
+ * e.g. cache misses around a benchmark. valid() is false if the counter couldn't be 
+ * opened (other platforms, no PMU access or perf_event_paranoid too restrictive), in 
+ * which case stop() returns 0.
+ */
+class PerfCounter
+{
+public:
+#if defined(__linux__)
+    PerfCounter(uint64_t _config=PERF_COUNT_HW_CACHE_MISSES)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = _config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~PerfCounter() { if (m_fd >= 0) close(m_fd); }
+
+    bool valid() { return m_fd >= 0; }
+
+    void start()
+    {
+        if (m_fd < 0)
+            return;
+        ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t stop()
+    {
+        uint64_t count = 0;
+        if (m_fd < 0)
+            return 0;
+        ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    }
+#else
+    PerfCounter(uint64_t _config=0) {}
+    bool valid() { return false; }
+    void start() {}
+    uint64_t stop() { return 0; }
+#endif
+
+private:
+    int m_fd = -1;
+
+};
+
+
+
+#endif // __PERF_COUNTER_H
@@ -1,151 +1,1236 @@
 
+#include <algorithm>
+#include <atomic>
 #include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <new>
+#include <unordered_map>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include <synapse/Debug>
 
 #include "quadtree.h"
+#include "parallel.h"
 
 
 float s_thetaBH = 1.0f;
 
 //
-QuadtreeBH::QuadtreeBH(size_t _max_vertices, const AABB2 &_aabb, uint32_t _level)
+template<int D>
+OrthtreeLeafSlab<D>::~OrthtreeLeafSlab()
 {
-    for (int i = 0; i < 4; i++)
-        m_children[i] = NULL;
-    m_level = _level;
-    m_maxVertices = _max_vertices;
-    m_vertexCount = 0;
-    m_aabb = _aabb;
-    m_vertices.clear();
+    for (auto chunk : m_chunks)
+        free(chunk);
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::destroy(QuadtreeBH *_qt)
+template<int D>
+typename OrthtreeLeafSlab<D>::vec_t *OrthtreeLeafSlab<D>::alloc()
+{
+    Block *block = m_free;
+    if (block != NULL)
+        m_free = block->next;
+    else
+    {
+        if (m_chunkUsed == LEAF_SLAB_CHUNK_BLOCKS)
+        {
+            m_chunks.push_back((Block *)malloc(sizeof(Block) * LEAF_SLAB_CHUNK_BLOCKS));
+            m_blockCount += LEAF_SLAB_CHUNK_BLOCKS;
+            m_chunkUsed = 0;
+        }
+        block = &m_chunks.back()[m_chunkUsed++];
+    }
+    return (vec_t *)block->vertices;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeLeafSlab<D>::release(vec_t *_block)
+{
+    Block *block = (Block *)_block;
+    block->next = m_free;
+    m_free = block;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeLeafSlab<D>::adopt(OrthtreeLeafSlab &_other)
+{
+    // the unused blocks of the other's last chunk become free blocks here
+    if (!_other.m_chunks.empty())
+        for (; _other.m_chunkUsed < LEAF_SLAB_CHUNK_BLOCKS; _other.m_chunkUsed++)
+            release((vec_t *)_other.m_chunks.back()[_other.m_chunkUsed].vertices);
+    while (_other.m_free != NULL)
+    {
+        Block *block = _other.m_free;
+        _other.m_free = block->next;
+        release((vec_t *)block->vertices);
+    }
+
+    // (before the last chunk, which alloc() continues to carve)
+    m_chunks.insert(m_chunks.empty() ? m_chunks.end() : m_chunks.end() - 1, 
+                    _other.m_chunks.begin(), _other.m_chunks.end());
+    m_blockCount += _other.m_blockCount;
+    _other.m_chunks.clear();
+    _other.m_blockCount = 0;
+    _other.m_chunkUsed = LEAF_SLAB_CHUNK_BLOCKS;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+typename OrthtreeLeafSlab<D>::vec_t *OrthtreeLeafSlab<D>::compact(size_t _blocks, std::vector<void *> &_out_old)
+{
+    _out_old.insert(_out_old.end(), m_chunks.begin(), m_chunks.end());
+    m_chunks.clear();
+    m_free = NULL;
+
+    // (the next alloc() starts a new regular chunk)
+    Block *chunk = (Block *)malloc(sizeof(Block) * std::max(_blocks, (size_t)1));
+    m_chunks.push_back(chunk);
+    m_blockCount = _blocks;
+    m_chunkUsed = LEAF_SLAB_CHUNK_BLOCKS;
+
+    return (vec_t *)chunk;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+OrthtreeBH<D>::OrthtreeBH(size_t _max_vertices, const AABB<D> &_aabb, QuadtreeFlags _flags) :
+    m_childMask(0), m_leafCount(1)
+{
+    // the root owns the state of the tree
+    m_tree = new OrthtreeState<D>(_max_vertices, _aabb, _flags);
+    m_tree->index.insert(m_key, this);
+}
+
+//
+template<int D>
+OrthtreeBH<D>::OrthtreeBH(OrthtreeState<D> *_tree, uint32_t _key) :
+    m_tree(_tree), m_key(_key), m_childMask(0), m_leafCount(1)
+{
+}
+
+//
+template<int D>
+OrthtreeBH<D>::~OrthtreeBH()
+{
+    // Only the root is ever destructed, child nodes live in raw (packed) arrays and are
+    // released here.
+    if (m_key != 1)
+        return;
+
+    std::vector<OrthtreeBH *> arrays;
+    OrthtreeTraversal<D> t(this);
+    while (OrthtreeBH *node = t.next())
+    {
+        // (slab blocks are released with the state)
+        if (node->m_localCount > MAX_VERTICES_PER_NODE)
+            free(node->m_vertices);
+        if (node->m_children != NULL)
+        {
+            arrays.push_back(node->m_children);
+            t.open(node);
+        }
+    }
+    for (auto children : arrays)
+        if (!m_tree->inNodePool(children))
+            ::operator delete(children);
+    ::operator delete(m_tree->nodePool);
+
+    delete m_tree;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::destroy(OrthtreeBH *_qt)
 {
     if (_qt == NULL)
         return;
 
-    for (int i = 0; i < 4; i++)
-        _qt->destroy(_qt->m_children[i]);
-    
+    // subtrees are part of the packed child arrays of their parents
+    if (_qt->m_key != 1)
+    {
+        SYN_WARNING("only the root of a OrthtreeBH can be destroyed");
+        return;
+    }
+
     delete _qt;
-    _qt = NULL;
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::insert(QuadtreeBH *_qt, const glm::vec2 &_v)
+template<int D>
+void OrthtreeBH<D>::insert(OrthtreeBH *_qt, const vec_t &_v)
 {
-    if (_qt->m_level > MAX_DEPTH)
+    OrthtreeState<D> *tree = _qt->m_tree;
+    if (_qt->m_vertexCount > tree->maxVertices)
+    {
+        SYN_WARNING("OrthtreeBH full, discarding new vertex: ", _qt->m_vertexCount, " > ", tree->maxVertices);
+        return;
+    }
+    if (_qt->m_leafCount > ORTHTREE_MAX_LEAF_COUNT(D) - (CHILD_COUNT - 1))
+    {
+        SYN_WARNING("OrthtreeBH leaf count at the limit, discarding new vertex: ", _qt->getLeafCount(), " leaves.");
         return;
+    }
 
-    if (_qt->m_vertexCount > _qt->m_maxVertices)
+    // keep track of changes
+    if (tree->insertLog.size() == INSERT_LOG_SIZE)
     {
-        SYN_WARNING("QuadtreeBH full, discarding new vertex: ", _qt->m_vertexCount, " > ", _qt->m_maxVertices);
+        tree->insertLog.clear();
+        tree->insertLogVersion = tree->version;
+    }
+    tree->insertLog.push_back(_v);
+    tree->version++;
+
+    _qt->insertBelow(_qt, _v);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::insert(OrthtreeBH *_qt, const vec_t *_v, size_t _count)
+{
+    // as many as insert() would accept one by one
+    OrthtreeState<D> *tree = _qt->m_tree;
+    size_t count = _qt->m_vertexCount > tree->maxVertices ? 0 : 
+                   std::min(_count, tree->maxVertices - _qt->m_vertexCount + 1);
+    if (count < _count)
+        SYN_WARNING("OrthtreeBH full, discarding ", _count - count, " new vertices: ", 
+                    _qt->m_vertexCount + _count, " > ", tree->maxVertices);
+    size_t leaf_limited = std::min(count, (size_t)(ORTHTREE_MAX_LEAF_COUNT(D) - _qt->m_leafCount) / (CHILD_COUNT - 1));
+    if (leaf_limited < count)
+    {
+        SYN_WARNING("OrthtreeBH leaf count at the limit, discarding ", count - leaf_limited, 
+                    " new vertices: ", _qt->getLeafCount(), " leaves.");
+        count = leaf_limited;
+    }
+    if (!count)
         return;
+
+    // keep track of changes (a batch larger than the log empties it)
+    if (tree->insertLog.size() + count > INSERT_LOG_SIZE)
+    {
+        tree->insertLog.clear();
+        tree->insertLogVersion = tree->version + (count > INSERT_LOG_SIZE ? count : 0);
     }
+    if (count <= INSERT_LOG_SIZE)
+        tree->insertLog.insert(tree->insertLog.end(), _v, _v + count);
+    tree->version += count;
+
+    // sort by location code at MAX_LEVEL (from quantized coordinates, which may differ 
+    // from the midpoint comparisons of insertBelow() for vertices on cell boundaries, 
+    // so that insertSorted() partitions by the latter; exact in quantized mode)
+    struct KeyedVertex
+    {
+        uint32_t key;
+        vec_t v;
+        bool operator<(const KeyedVertex &_other) const { return key < _other.key; }
+    };
+    std::vector<KeyedVertex> keyed(count);
+    vec_t scale = (float)(1u << MAX_LEVEL) / (tree->aabb.v1 - tree->aabb.v0);
+    int max_cell = (1 << MAX_LEVEL) - 1;
+    parallel_for(count, [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+        {
+            cell_t cell;
+            if (tree->quantized)
+            {
+                cell_t q = tree->quantize(_v[i]);
+                for (int d = 0; d < D; d++)
+                    cell[d] = q[d] >> (32 - MAX_LEVEL);
+            }
+            else
+            {
+                vec_t c = (_v[i] - tree->aabb.v0) * scale;
+                for (int d = 0; d < D; d++)
+                    cell[d] = (uint32_t)std::min(std::max((int)floorf(c[d]), 0), max_cell);
+            }
+            keyed[i] = { OrthtreeIndex<D>::levelKey(cell, MAX_LEVEL), _v[i] };
+        }
+    });
+    // (batches from a Morton-ordered source are already sorted)
+    if (!std::is_sorted(keyed.begin(), keyed.end()))
+        parallel_sort(keyed.begin(), keyed.end(), std::less<KeyedVertex>());
+    std::vector<vec_t> sorted(count);
+    parallel_for(count, [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+            sorted[i] = keyed[i].v;
+    });
+
+    // (compressed nodes may have to be rekeyed or split at edges, see insertBelow())
+    if (tree->compressed)
+        for (auto &v : sorted)
+            _qt->insertBelow(_qt, v);
+    else if (count >= INSERT_PARALLEL_MIN && parallel_thread_count() > 1)
+        _qt->insertParallel(_qt, sorted.data(), count);
+    else
+        _qt->insertSorted(_qt, sorted.data(), count);
+}
 
-    // add to count and update mean node
-    _qt->m_total += _v;
-    _qt->m_vertexCount++;
-    _qt->m_mean = _qt->m_total / (float)_qt->m_vertexCount;
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::insertAggregate(OrthtreeBH *_qt, 
+                                    uint32_t _key, 
+                                    const vec_t &_total, 
+                                    uint32_t _count)
+{
+    if (_qt->m_tree->compressed)
+    {
+        SYN_WARNING("insertAggregate() not supported by compressed trees.");
+        return;
+    }
+    if (_qt->m_leafCount == ORTHTREE_MAX_LEAF_COUNT(D))
+    {
+        SYN_WARNING("OrthtreeBH leaf count at the limit, discarding aggregate.");
+        return;
+    }
 
-    // tree is not split
-    if (_qt->m_children[0] == NULL)
+    uint32_t level = OrthtreeIndex<D>::level(_key);
+    OrthtreeBH *path[MAX_LEVEL + 1];
+    OrthtreeBH *node = _qt;
+    for (uint32_t l = 0; ; l++)
     {
-        // number of vertices here is not yet at max capacity
-        if (_qt->m_vertices.size() < MAX_VERTICES_PER_NODE)
-            _qt->m_vertices.push_back(_v);
+        node->m_total += _total;
+        node->m_vertexCount += _count;
+        path[l] = node;
+        if (l == level)
+            break;
 
-        // this node is full, split tree and distribute vertices accordingly
-        else
+        uint8_t idx = (_key >> (D * (level - l - 1))) & (CHILD_COUNT - 1);
+        OrthtreeBH *child = node->getChild(idx);
+        if (child == NULL)
         {
-            _qt->m_vertices.push_back(_v);
+            // a new chain down to the aggregate holds one leaf, which is an additional 
+            // leaf unless it replaces an (empty) leaf
+            bool had_children = (node->m_children != NULL);
+            child = node->addChild(node, idx);
+            for (uint32_t i = 0; i <= l && had_children; i++)
+                path[i]->m_leafCount++;
+        }
+        node = child;
+    }
+}
 
-            if (_qt->m_level != MAX_DEPTH)
-            {
-                _qt->split(_qt);
+//---------------------------------------------------------------------------------------
+template<int D>
+uint32_t OrthtreeBH<D>::insertBelow(OrthtreeBH *_qt, const vec_t &_v)
+{
+    OrthtreeState<D> *tree = _qt->m_tree;
+    uint32_t level = _qt->getLevel();
+    cell_t cell = OrthtreeIndex<D>::cell(_qt->m_key);
+    cell_t q = tree->quantized ? tree->quantize(_v) : cell_t(0u);
 
-                //
-                for (auto &v : _qt->m_vertices)
-                {
-                    uint8_t idx = _qt->getChildIndex(_qt, v);
-                    _qt->insert(_qt->m_children[idx], v);
-                }
-                _qt->m_vertices.clear();
+    // nodes passed on the way down, whose leaf counts change with new children and splits
+    OrthtreeBH *path[ORTHTREE_MAX_DEPTH_COMPRESSED(D) + 1];
+    uint32_t depth = 0;
+    uint32_t new_leaves = 0;
+
+    OrthtreeBH *node = _qt;
+    while (true)
+    {
+        // add to count and sum
+        node->m_total += _v;
+        node->m_vertexCount++;
+        path[depth++] = node;
+
+        // tree is not split
+        if (node->m_children == NULL)
+        {
+            // number of vertices here is not yet at max capacity (or cannot be split)
+            if (node->m_localCount < MAX_VERTICES_PER_NODE || level == tree->maxDepth)
+                node->pushVertex(node, _v);
+
+            // this node is full, split tree and distribute vertices accordingly
+            else
+            {
+                uint32_t split_leaves = node->split(node, _v);
+                for (uint32_t i = 0; i < depth; i++)
+                    path[i]->m_leafCount += split_leaves;
+                new_leaves += split_leaves;
             }
+
+            return new_leaves;
+        }
+
+        // tree is already split at this level, put point in correct child quadrant
+        uint8_t idx = childIndex(tree, level, cell, _v, q);
+        OrthtreeBH *child = node->getChild(idx);
+        if (child == NULL)
+        {
+            child = node->addChild(node, idx);
+            for (uint32_t i = 0; i < depth; i++)
+                path[i]->m_leafCount++;
+            new_leaves++;
+        }
+        // compressed child (more than one level down) not holding _v: insert a node 
+        // holding both between them
+        else if (child->getLevel() > level + 1 && 
+                 node->descendKey(node, _v, child->getLevel()) != child->m_key)
+        {
+            node->splitEdge(node, idx, _v);
+            for (uint32_t i = 0; i < depth; i++)
+                path[i]->m_leafCount++;
+            return new_leaves + 1;
+        }
+
+        node = child;
+        if (node->getLevel() == level + 1)
+        {
+            cell = childCell(cell, idx);
+            level++;
+        }
+        else
+        {
+            cell = OrthtreeIndex<D>::cell(node->m_key);
+            level = node->getLevel();
         }
     }
-    // tree is already split at this level, put point in correct child quandrant
-    else if (_qt->m_children[0] != NULL)
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+uint32_t OrthtreeBH<D>::insertSorted(OrthtreeBH *_qt, 
+                                     vec_t *_v, 
+                                     size_t _n, 
+                                     OrthtreeLeafSlab<D> *_leaves, 
+                                     InsertSchedule *_schedule)
+{
+    // Merges the (Morton-sorted) vertices into the subtree _qt, in regular mode, 
+    // partitioning them by quadrant and recursing into each child; returns the number of
+    // leaves added (not counting deferred subtrees, see insertParallel()).
+    if (_schedule != NULL && _n <= _schedule->grain)
     {
-        uint8_t idx = _qt->getChildIndex(_qt, _v);
-        _qt->insert(_qt->m_children[idx], _v);
+        _schedule->tasks.push_back({ _qt, _v, _n, 0 });
+        return 0;
     }
+    OrthtreeState<D> *tree = _qt->m_tree;
+    OrthtreeLeafSlab<D> &leaves = _leaves != NULL ? *_leaves : tree->leaves;
+    uint32_t level = _qt->getLevel();
+
+    // add to count and sum, once for all vertices
+    vec_t total = vec_t(0.0f);
+    for (size_t i = 0; i < _n; i++)
+        total += _v[i];
+    _qt->m_total += total;
+    _qt->m_vertexCount += _n;
 
+    // leaf: room for all vertices (or cannot be split), or split once, distributing its
+    // own vertices (never more than MAX_VERTICES_PER_NODE here) with the new ones
+    std::vector<vec_t> merged;
+    int32_t new_leaves = 0;
+    if (_qt->m_children == NULL)
+    {
+        uint32_t n = _qt->m_localCount;
+        if (n + _n <= MAX_VERTICES_PER_NODE || level == tree->maxDepth)
+        {
+            for (size_t i = 0; i < _n; i++)
+                _qt->pushVertex(_qt, _v[i], _leaves);
+            return 0;
+        }
+
+        if (n)
+        {
+            merged.resize(n + _n);
+            std::copy(_qt->m_vertices, _qt->m_vertices + n, merged.begin());
+            std::copy(_v, _v + _n, merged.begin() + n);
+            _v = merged.data();
+            _n = merged.size();
+            leaves.release(_qt->m_vertices);
+        }
+        _qt->m_vertices = NULL;
+        _qt->m_localCount = 0;
+        new_leaves = -1;    // (no longer a leaf itself)
+    }
+
+    // quadrant ranges, by the same midpoint comparisons (or bits) as insertBelow() (in
+    // quadrant order, so that sorted vertices are left in place): partitioned by the 
+    // highest bit of the child index first, then each half by the next
+    cell_t cell = OrthtreeIndex<D>::cell(_qt->m_key);
+    vec_t h = tree->cellMin(level + 1, childCell(cell, CHILD_COUNT - 1));
+    auto quadrant = [&](const vec_t &_p)
+    {
+        return tree->quantized ? OrthtreeState<D>::quadrant(tree->quantize(_p), level) : 
+                                 OrthtreeBH::quadrant(_p, h);
+    };
+    vec_t *bounds[CHILD_COUNT + 1] = { _v };
+    bounds[CHILD_COUNT] = _v + _n;
+    for (int bit = D - 1; bit >= 0; bit--)
+    {
+        uint32_t step = 1u << bit;
+        for (uint32_t i = 0; i < CHILD_COUNT; i += 2 * step)
+            bounds[i + step] = std::partition(bounds[i], bounds[i + 2 * step], 
+                                              [&](const vec_t &_p) { return !(quadrant(_p) & step); });
+    }
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < CHILD_COUNT; i++)
+        if (bounds[i] != bounds[i + 1])
+            mask |= 1 << i;
+
+    // create the missing children first (which moves their siblings), then fill them
+    uint8_t new_children = mask & ~_qt->m_childMask;
+    if (new_children)
+    {
+        _qt->addChildren(_qt, new_children, _leaves == NULL);
+        new_leaves += __builtin_popcount(new_children);
+    }
+    // (deferred subtrees may refer to the merged vertices)
+    if (_schedule != NULL && !merged.empty())
+        _schedule->buffers.push_back(std::move(merged));
+    for (uint8_t i = 0; i < CHILD_COUNT; i++)
+        if (mask & (1 << i))
+            new_leaves += _qt->insertSorted(_qt->getChild(i), 
+                                            bounds[i], 
+                                            bounds[i + 1] - bounds[i], 
+                                            _leaves, 
+                                            _schedule);
+
+    _qt->m_leafCount += new_leaves;
+    return new_leaves;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+uint32_t OrthtreeBH<D>::insertParallel(OrthtreeBH *_qt, vec_t *_v, size_t _n)
+{
+    // top levels, down to subtrees of similar size (as the export tasks)
+    InsertSchedule schedule;
+    schedule.grain = std::max(_n / (16 * parallel_thread_count()), (size_t)4096);
+    uint32_t new_leaves = _qt->insertSorted(_qt, _v, _n, NULL, &schedule);
+
+    // fill the subtrees, handed out dynamically; each thread allocates leaf blocks from 
+    // its own slab and leaves the index alone
+    OrthtreeState<D> *tree = _qt->m_tree;
+    std::vector<OrthtreeLeafSlab<D>> slabs(parallel_thread_count());
+    std::atomic<size_t> next = { 0 };
+    parallel_for(slabs.size(), [&](size_t, size_t, size_t _thread)
+    {
+        size_t t;
+        while ((t = next++) < schedule.tasks.size())
+        {
+            InsertTask &task = schedule.tasks[t];
+            task.newLeaves = task.node->insertSorted(task.node, task.v, task.n, &slabs[_thread]);
+        }
+    }, 1);
+    for (auto &slab : slabs)
+        tree->leaves.adopt(slab);
+
+    // leaves added below each task node to its ancestors, and the (new or moved) nodes
+    // of the subtree to the index
+    for (auto &task : schedule.tasks)
+    {
+        uint32_t level = task.node->getLevel();
+        OrthtreeBH *node = _qt;
+        for (uint32_t l = _qt->getLevel(); l < level; l++)
+        {
+            node->m_leafCount += task.newLeaves;
+            node = node->getChild((task.node->m_key >> (D * (level - l - 1))) & (CHILD_COUNT - 1));
+        }
+        new_leaves += task.newLeaves;
+
+        OrthtreeTraversal<D> t(task.node);
+        while (OrthtreeBH *subtree_node = t.next())
+        {
+            tree->index.insert(subtree_node->m_key, subtree_node);
+            t.open(subtree_node);
+        }
+    }
+    tree->relocations++;
+
+    return new_leaves;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::pushVertex(OrthtreeBH *_qt, const vec_t &_v, OrthtreeLeafSlab<D> *_leaves)
+{
+    // Leaves hold up to MAX_VERTICES_PER_NODE vertices in a slab block; leaves at 
+    // maxDepth can't be split and overflow to a heap buffer, doubling it when full.
+    OrthtreeLeafSlab<D> &leaves = _leaves != NULL ? *_leaves : _qt->m_tree->leaves;
+    uint32_t n = _qt->m_localCount;
+    if (n == 0)
+        _qt->m_vertices = leaves.alloc();
+    else if (n == MAX_VERTICES_PER_NODE)
+    {
+        vec_t *overflow = (vec_t *)malloc(sizeof(vec_t) * 2 * n);
+        memcpy(overflow, _qt->m_vertices, sizeof(vec_t) * n);
+        leaves.release(_qt->m_vertices);
+        _qt->m_vertices = overflow;
+    }
+    else if (n % MAX_VERTICES_PER_NODE == 0 && 
+             ((n / MAX_VERTICES_PER_NODE) & (n / MAX_VERTICES_PER_NODE - 1)) == 0)
+        _qt->m_vertices = (vec_t *)realloc(_qt->m_vertices, sizeof(vec_t) * 2 * n);
+
+    _qt->m_vertices[_qt->m_localCount++] = _v;
 }
 
 //---------------------------------------------------------------------------------------
-uint8_t QuadtreeBH::getChildIndex(QuadtreeBH *_qt, const glm::vec2 &_v)
+template<int D>
+uint8_t OrthtreeBH<D>::getChildIndex(OrthtreeBH *_qt, const vec_t &_v)
 {
-    glm::vec2 h = _qt->m_aabb.midpoint();
-    return ((_v.x > h.x) + ((_v.y > h.y) << 1));
+    OrthtreeState<D> *tree = _qt->m_tree;
+    cell_t cell = OrthtreeIndex<D>::cell(_qt->m_key);
+    cell_t q = tree->quantized ? tree->quantize(_v) : cell_t(0u);
+    return childIndex(tree, _qt->getLevel(), cell, _v, q);
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::split(QuadtreeBH *_qt)
+template<int D>
+uint32_t OrthtreeBH<D>::split(OrthtreeBH *_qt, const vec_t &_v)
 {
-    AABB2 aabb = _qt->m_aabb;
-    glm::vec2 h = aabb.midpoint();
-    _qt->m_children[0] = new QuadtreeBH(_qt->m_maxVertices, AABB2(aabb.v0.x, h.x, aabb.v0.y, h.y), _qt->m_level + 1);
-    _qt->m_children[1] = new QuadtreeBH(_qt->m_maxVertices, AABB2(h.x, aabb.v1.x, aabb.v0.y, h.y), _qt->m_level + 1);
-    _qt->m_children[2] = new QuadtreeBH(_qt->m_maxVertices, AABB2(aabb.v0.x, h.x, h.y, aabb.v1.y), _qt->m_level + 1);
-    _qt->m_children[3] = new QuadtreeBH(_qt->m_maxVertices, AABB2(h.x, aabb.v1.x, h.y, aabb.v1.y), _qt->m_level + 1);
+    uint32_t n = _qt->m_localCount;
+
+    // Compressed mode: shrink the leaf to the deepest cell holding all its vertices, so 
+    // that they are split across (at least two) children. If they all share a cell at
+    // maxDepth, the leaf becomes a bucket instead. (The root keeps its bounds, and is 
+    // split into a single child if needed.)
+    if (_qt->m_tree->compressed && _qt->m_key != 1)
+    {
+        uint32_t max_depth = _qt->m_tree->maxDepth;
+        uint32_t key = _qt->descendKey(_qt, _v, max_depth);
+        uint32_t diff = 0;
+        for (uint32_t i = 0; i < n; i++)
+            diff |= key ^ _qt->descendKey(_qt, _qt->m_vertices[i], max_depth);
+
+        uint32_t prefix = diff ? key >> (D * ((31 - __builtin_clz(diff)) / D + 1)) : key;
+        if (prefix != _qt->m_key)
+            _qt->rekey(_qt, prefix);
+        if (!diff)
+        {
+            _qt->pushVertex(_qt, _v);
+            return 0;
+        }
+    }
+
+    // the vertices of the leaf (never more than MAX_VERTICES_PER_NODE, since leaves at 
+    // maxDepth aren't split) plus the new vertex (already counted in _qt); the block is
+    // released first, so that it can be reused by a child
+    vec_t vertices[MAX_VERTICES_PER_NODE];
+    memcpy(vertices, _qt->m_vertices, sizeof(vec_t) * n);
+    _qt->m_tree->leaves.release(_qt->m_vertices);
+    _qt->m_vertices = NULL;
+    _qt->m_localCount = 0;
+
+    // only create children for occupied quadrants
+    uint8_t idx[MAX_VERTICES_PER_NODE + 1];
+    uint8_t mask = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        idx[i] = _qt->getChildIndex(_qt, vertices[i]);
+        mask |= 1 << idx[i];
+    }
+    idx[n] = _qt->getChildIndex(_qt, _v);
+    mask |= 1 << idx[n];
+
+    int count = __builtin_popcount(mask);
+    _qt->m_children = (OrthtreeBH *)::operator new(sizeof(OrthtreeBH) * count);
+    _qt->m_childMask = mask;
+    for (uint8_t i = 0, k = 0; i < CHILD_COUNT; i++)
+    {
+        if (!(mask & (1 << i)))
+            continue;
+        OrthtreeBH *child = new (&_qt->m_children[k++]) OrthtreeBH(_qt->m_tree, OrthtreeIndex<D>::childKey(_qt->m_key, i));
+        _qt->m_tree->index.insert(child->m_key, child);
+    }
+
+    // distribute (the children may split in turn); returns the number of leaves added
+    uint32_t new_leaves = count - 1;
+    for (uint32_t i = 0; i < n; i++)
+        new_leaves += _qt->insertBelow(_qt->getChild(idx[i]), vertices[i]);
+    new_leaves += _qt->insertBelow(_qt->getChild(idx[n]), _v);
+
+    return new_leaves;
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::getAABBLines(QuadtreeBH *_qt, std::vector<glm::vec2> &_out_vec_lines)
+template<int D>
+OrthtreeBH<D> *OrthtreeBH<D>::addChild(OrthtreeBH *_qt, uint8_t _idx)
 {
-    // add aabb for this level
-    AABB2 aabb = _qt->m_aabb;
+    _qt->addChildren(_qt, 1 << _idx);
+    return _qt->getChild(_idx);
+}
 
-    // no children, add bounding box
-    if (_qt->m_children[0] == NULL)
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::addChildren(OrthtreeBH *_qt, uint8_t _mask, bool _index)
+{
+    // The packed children have to be moved to make room for the new ones, so that the
+    // index has to be updated (and any node pointers held elsewhere are invalidated).
+    OrthtreeState<D> *tree = _qt->m_tree;
+    uint8_t mask = _qt->m_childMask | _mask;
+    OrthtreeBH *children = (OrthtreeBH *)::operator new(sizeof(OrthtreeBH) * __builtin_popcount(mask));
+    for (uint8_t i = 0, k = 0; i < CHILD_COUNT; i++)
     {
-        // if (_qt->m_vertices.size() > 0)
-        // {
-            _out_vec_lines.push_back({ aabb.v0.x, aabb.v0.y });
-            _out_vec_lines.push_back({ aabb.v1.x, aabb.v0.y });
-            _out_vec_lines.push_back({ aabb.v0.x, aabb.v1.y });
-            _out_vec_lines.push_back({ aabb.v1.x, aabb.v1.y });
-            _out_vec_lines.push_back({ aabb.v0.x, aabb.v0.y });
-            _out_vec_lines.push_back({ aabb.v0.x, aabb.v1.y });
-            _out_vec_lines.push_back({ aabb.v1.x, aabb.v0.y });
-            _out_vec_lines.push_back({ aabb.v1.x, aabb.v1.y });
-        // }
+        if (!(mask & (1 << i)))
+            continue;
+        if (_qt->m_childMask & (1 << i))
+            new (&children[k]) OrthtreeBH(*_qt->getChild(i));
+        else
+            new (&children[k]) OrthtreeBH(tree, OrthtreeIndex<D>::childKey(_qt->m_key, i));
+        if (_index)
+            tree->index.insert(children[k].m_key, &children[k]);
+        k++;
     }
-    else
+
+    if (_qt->m_children != NULL)
     {
-        for (int i = 0; i < 4; i++)
-            _qt->getAABBLines(_qt->m_children[i], _out_vec_lines);
+        if (!tree->inNodePool(_qt->m_children))
+            ::operator delete(_qt->m_children);
+        if (_index)
+            tree->relocations++;
     }
+    _qt->m_children = children;
+    _qt->m_childMask = mask;
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::getVertices(QuadtreeBH *_qt, std::vector<glm::vec2> &_out_vec_points)
+template<int D>
+uint32_t OrthtreeBH<D>::descendKey(OrthtreeBH *_qt, const vec_t &_v, uint32_t _level)
 {
-    if (_qt->m_children[0] == NULL)
-        _out_vec_points.insert(_out_vec_points.end(), _qt->m_vertices.begin(), _qt->m_vertices.end());
-    else
+    // location code at _level on the path of _v below _qt, using the same midpoint 
+    // comparisons (or bits) as insertBelow()
+    OrthtreeState<D> *tree = _qt->m_tree;
+    uint32_t key = _qt->m_key;
+    cell_t cell = OrthtreeIndex<D>::cell(key);
+    cell_t q = tree->quantized ? tree->quantize(_v) : cell_t(0u);
+    for (uint32_t level = _qt->getLevel(); level < _level; level++)
+    {
+        uint8_t idx = childIndex(tree, level, cell, _v, q);
+        key = OrthtreeIndex<D>::childKey(key, idx);
+        cell = childCell(cell, idx);
+    }
+    return key;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+uint32_t OrthtreeBH<D>::splitEdge(OrthtreeBH *_qt, uint8_t _idx, const vec_t &_v)
+{
+    // The (compressed) child in quadrant _idx doesn't hold _v: replace it by a node at 
+    // the deepest common ancestor of the two, with the child and a new leaf for _v as 
+    // children. Returns the number of leaves added (1).
+    OrthtreeState<D> *tree = _qt->m_tree;
+    OrthtreeBH *slot = _qt->getChild(_idx);
+    uint32_t key = slot->m_key;
+    uint32_t v_key = _qt->descendKey(_qt, _v, slot->getLevel());
+    uint32_t shift = D * ((31 - __builtin_clz(key ^ v_key)) / D);
+    uint32_t parent_key = key >> (shift + D);
+    uint8_t idx = (key >> shift) & (CHILD_COUNT - 1);
+    uint8_t v_idx = (v_key >> shift) & (CHILD_COUNT - 1);
+
+    OrthtreeBH *children = (OrthtreeBH *)::operator new(sizeof(OrthtreeBH) * 2);
+    OrthtreeBH *child = new (&children[idx > v_idx]) OrthtreeBH(*slot);
+    OrthtreeBH *leaf = new (&children[v_idx > idx]) OrthtreeBH(tree, OrthtreeIndex<D>::childKey(parent_key, v_idx));
+    leaf->pushVertex(leaf, _v);
+    leaf->m_total = _v;
+    leaf->m_vertexCount = 1;
+
+    OrthtreeBH *node = new (slot) OrthtreeBH(tree, parent_key);
+    node->m_children = children;
+    node->m_childMask = (1 << idx) | (1 << v_idx);
+    node->m_total = child->m_total + _v;
+    node->m_vertexCount = child->m_vertexCount + 1;
+    node->m_leafCount = child->m_leafCount + 1;
+
+    tree->index.insert(key, child);
+    tree->index.insert(leaf->m_key, leaf);
+    tree->index.insert(parent_key, node);
+    tree->relocations++;
+
+    return 1;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::rekey(OrthtreeBH *_qt, uint32_t _key)
+{
+    OrthtreeIndex<D> &index = _qt->m_tree->index;
+    index.erase(_qt->m_key);
+    _qt->m_key = _key;
+    index.insert(_key, _qt);
+}
+
+//---------------------------------------------------------------------------------------
+// van Emde Boas order of the internal nodes within _height levels (in nodes, since 
+// compressed trees skip levels) from _qt: the top half of the levels first, then each of
+// the subtrees hanging below it
+template<int D>
+void OrthtreeBH<D>::vebOrder(OrthtreeBH *_qt, uint32_t _height, std::vector<OrthtreeBH *> &_out_order)
+{
+    if (_qt->m_children == NULL)
+        return;
+
+    if (_height == 1)
+    {
+        _out_order.push_back(_qt);
+        return;
+    }
+
+    uint32_t top = _height / 2;
+    vebOrder(_qt, top, _out_order);
+
+    // the internal nodes 'top' levels below _qt, each the root of a bottom subtree
+    struct Entry { OrthtreeBH *node; uint32_t depth; };
+    Entry stack[ORTHTREE_STACK_SIZE(D)];
+    int n = 0;
+    stack[n++] = { _qt, 0 };
+    while (n)
+    {
+        Entry e = stack[--n];
+        if (e.depth == top)
+            vebOrder(e.node, _height - top, _out_order);
+        else
+            for (int i = e.node->childCount() - 1; i >= 0; i--)
+                stack[n++] = { &e.node->m_children[i], e.depth + 1 };
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::compact(OrthtreeBH *_qt, QuadtreeLayout _layout)
+{
+    if (_qt->m_key != 1)
     {
-        for (int i = 0; i < 4; i++)
-            _qt->getVertices(_qt->m_children[i], _out_vec_points);
+        SYN_WARNING("only the root of a OrthtreeBH can be compacted");
+        return;
+    }
+    OrthtreeState<D> *tree = _qt->m_tree;
+
+    // internal nodes, in the order their (packed) children are laid out
+    std::vector<OrthtreeBH *> order;
+    switch (_layout)
+    {
+        case QUADTREE_LAYOUT_BFS:
+        {
+            order.push_back(_qt);
+            for (size_t i = 0; i < order.size(); i++)
+                for (int k = 0; k < order[i]->childCount(); k++)
+                    if (order[i]->m_children[k].m_children != NULL)
+                        order.push_back(&order[i]->m_children[k]);
+            break;
+        }
+
+        case QUADTREE_LAYOUT_VEB:
+            vebOrder(_qt, _qt->depth(_qt), order);
+            break;
+
+        default:
+        {
+            OrthtreeTraversal<D> t(_qt);
+            while (OrthtreeBH *node = t.next())
+            {
+                if (node->m_children == NULL)
+                    continue;
+                order.push_back(node);
+                t.open(node);
+            }
+            break;
+        }
+    }
+    if (order.empty())
+        return;
+
+    // new locations of the child arrays, keyed on the old ones
+    std::unordered_map<OrthtreeBH *, size_t> offsets;
+    offsets.reserve(order.size());
+    size_t n = 0;
+    for (auto node : order)
+    {
+        offsets[node->m_children] = n;
+        n += node->childCount();
+    }
+
+    // copy the nodes, then point them to the new child arrays (the copies still hold 
+    // the old ones)
+    OrthtreeBH *pool = (OrthtreeBH *)::operator new(sizeof(OrthtreeBH) * n);
+    for (auto node : order)
+    {
+        size_t offset = offsets[node->m_children];
+        for (int k = 0; k < node->childCount(); k++)
+            new (&pool[offset + k]) OrthtreeBH(node->m_children[k]);
     }
+    _qt->m_children = &pool[offsets[_qt->m_children]];
+    size_t leaf_blocks = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (pool[i].m_children != NULL)
+            pool[i].m_children = &pool[offsets[pool[i].m_children]];
+        else if (pool[i].m_localCount && pool[i].m_localCount <= MAX_VERTICES_PER_NODE)
+            leaf_blocks++;
+        tree->index.insert(pool[i].m_key, &pool[i]);
+    }
+
+    // leaf vertices (in slab blocks) in pool order
+    std::vector<void *> old_chunks;
+    vec_t *blocks = tree->leaves.compact(leaf_blocks, old_chunks);
+    for (size_t i = 0; i < n; i++)
+    {
+        OrthtreeBH *node = &pool[i];
+        if (node->m_children != NULL || !node->m_localCount || node->m_localCount > MAX_VERTICES_PER_NODE)
+            continue;
+        memcpy(blocks, node->m_vertices, sizeof(vec_t) * node->m_localCount);
+        node->m_vertices = blocks;
+        blocks += MAX_VERTICES_PER_NODE;
+    }
+    for (auto chunk : old_chunks)
+        free(chunk);
+
+    // release the old child arrays
+    for (auto &offset : offsets)
+        if (!tree->inNodePool(offset.first))
+            ::operator delete(offset.first);
+    ::operator delete(tree->nodePool);
+    tree->nodePool = pool;
+    tree->nodePoolBytes = sizeof(OrthtreeBH) * n;
+    tree->relocations++;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+AABB<D> OrthtreeBH<D>::getAABB()
+{
+    if (m_key == 1)
+        return m_tree->aabb;
+
+    uint32_t level = getLevel();
+    cell_t cell = OrthtreeIndex<D>::cell(m_key);
+    return AABB<D>(m_tree->cellMin(level, cell), m_tree->cellMin(level, cell + cell_t(1u)));
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::approxBH(QuadtreeBH *_qt, 
-                          const glm::vec2 &_cmp_vertex, 
-                          std::vector<glm::vec3> &_out_v_bh)
+template<int D>
+size_t OrthtreeBH<D>::nodeCount(OrthtreeBH *_qt)
+{
+    struct CountVisitor : OrthtreeVisitor<D>
+    {
+        bool openNode(OrthtreeBH *) { n++; return true; }
+        size_t n = 0;
+    } visitor;
+    _qt->traverse(_qt, visitor);
+    return visitor.n;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+size_t OrthtreeBH<D>::memoryUsage(OrthtreeBH *_qt)
+{
+    struct MemoryVisitor : OrthtreeVisitor<D>
+    {
+        bool openNode(OrthtreeBH *_qt)
+        {
+            bytes += sizeof(OrthtreeBH);
+            size_t n = _qt->getLocalVertices().size();
+            if (n > MAX_VERTICES_PER_NODE)
+            {
+                // capacity of the overflow storage (see pushVertex())
+                size_t capacity = 2 * MAX_VERTICES_PER_NODE;
+                while (capacity < n)
+                    capacity *= 2;
+                bytes += sizeof(vec_t) * capacity;
+            }
+            return !_qt->isLeaf();
+        }
+        size_t bytes = 0;
+    } visitor;
+    _qt->traverse(_qt, visitor);
+
+    return visitor.bytes + 
+           sizeof(OrthtreeState<D>) + 
+           _qt->m_tree->index.memoryUsage() + 
+           _qt->m_tree->leaves.memoryUsage();
+}
+
+// The D * 2^(D-1) edges of a box as line vertices, axis by axis: for each corner on the
+// lower side of the axis, the corner and the one across (the 4 edges of a 2D box are
+// x0-x1 at y0 and y1, then y0-y1 at x0 and x1)
+template<int D>
+static inline void aabbLines(const AABB<D> &_aabb, glm::vec<D, float> *_out)
+{
+    for (int d = 0; d < D; d++)
+    {
+        for (uint32_t c = 0; c < (1u << D); c++)
+        {
+            if (c & (1u << d))
+                continue;
+            for (uint32_t e : { c, c | (1u << d) })
+            {
+                for (int k = 0; k < D; k++)
+                    (*_out)[k] = (e & (1u << k)) ? _aabb.v1[k] : _aabb.v0[k];
+                _out++;
+            }
+        }
+    }
+}
+
+// Leaf AABBs (within a view) into a buffer, as AABB_LINE_VERTICES line vertices or 1 
+// box_t per leaf
+template<int D, typename T, size_t N>
+struct LeafAABBVisitor : OrthtreeVisitor<D>
+{
+    typedef typename OrthtreeBH<D>::vec_t vec_t;
+
+    LeafAABBVisitor(const AABB<D> *_view, T *_out, size_t _max_count, size_t &_out_count) :
+        view(_view), out(_out), max_count(_max_count), count(_out_count)
+    {}
+
+    bool openNode(OrthtreeBH<D> *_qt)
+    {
+        AABB<D> aabb = _qt->getAABB();
+        if (view != NULL && !view->intersects(aabb))
+            return false;
+        if (!_qt->isLeaf())
+            return true;
+
+        if (count + N > max_count)
+            full = true;
+        else
+        {
+            write(aabb, out + count);
+            count += N;
+        }
+        return false;
+    }
+    bool done() { return full; }
+
+    static void write(const AABB<D> &_aabb, vec_t *_out) { aabbLines(_aabb, _out); }
+    static void write(const AABB<2> &_aabb, glm::vec4 *_out) { *_out = glm::vec4(_aabb.v0, _aabb.v1); }
+    static void write(const AABB<D> &_aabb, AABB<D> *_out) { *_out = _aabb; }
+
+    const AABB<D> *view;
+    T *out;
+    size_t max_count;
+    size_t &count;
+    bool full = false;
+};
+
+// A subtree exported by one task, with the offsets of its first vertex and leaf
+template<int D>
+struct ExportTask
+{
+    OrthtreeBH<D> *node;
+    size_t vertex;
+    size_t leaf;
+};
+
+// Subtrees of similar size, in depth-first order, for parallel exports
+template<int D>
+static void exportTasks(OrthtreeBH<D> *_qt, std::vector<ExportTask<D>> &_out_tasks)
+{
+    size_t grain = std::max(_qt->getVertexCount() / (16 * parallel_thread_count()), (size_t)4096);
+    std::vector<ExportTask<D>> stack = { { _qt, 0, 0 } };
+    while (!stack.empty())
+    {
+        ExportTask<D> task = stack.back();
+        stack.pop_back();
+        if (task.node->isLeaf() || task.node->getVertexCount() <= grain)
+        {
+            _out_tasks.push_back(task);
+            continue;
+        }
+
+        // push in reverse, to pop in order
+        OrthtreeBH<D> *children = task.node->getChildren();
+        size_t vertex = task.vertex + task.node->getVertexCount();
+        size_t leaf = task.leaf + task.node->getLeafCount();
+        for (int i = task.node->getChildCount() - 1; i >= 0; i--)
+        {
+            vertex -= children[i].getVertexCount();
+            leaf -= children[i].getLeafCount();
+            stack.push_back({ &children[i], vertex, leaf });
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::exportVertices(OrthtreeBH *_qt, vec_t *_out_points)
+{
+    std::vector<ExportTask<D>> tasks;
+    exportTasks(_qt, tasks);
+    parallel_for(tasks.size(), [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+        {
+            vec_t *out = _out_points + tasks[i].vertex;
+            OrthtreeTraversal<D> t(tasks[i].node);
+            while (OrthtreeBH *node = t.next())
+            {
+                if (!node->isLeaf())
+                {
+                    t.open(node);
+                    continue;
+                }
+                if (node->m_localCount)
+                    memcpy(out, node->m_vertices, sizeof(vec_t) * node->m_localCount);
+                out += node->m_localCount;
+                if (node->isAggregate())
+                    out = std::fill_n(out, node->m_vertexCount - node->m_localCount, node->getMean());
+            }
+        }
+    }, 1);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D, typename T, size_t N>
+static void exportLeafAABBs(OrthtreeBH<D> *_qt, T *_out)
+{
+    std::vector<ExportTask<D>> tasks;
+    exportTasks(_qt, tasks);
+    parallel_for(tasks.size(), [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+        {
+            T *out = _out + N * tasks[i].leaf;
+            OrthtreeTraversal<D> t(tasks[i].node);
+            while (OrthtreeBH<D> *node = t.next())
+            {
+                if (!node->isLeaf())
+                    t.open(node);
+                else
+                {
+                    LeafAABBVisitor<D, T, N>::write(node->getAABB(), out);
+                    out += N;
+                }
+            }
+        }
+    }, 1);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::exportAABBs(OrthtreeBH *_qt, box_t *_out_aabbs)
+{
+    exportLeafAABBs<D, box_t, 1>(_qt, _out_aabbs);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::exportAABBLines(OrthtreeBH *_qt, vec_t *_out_lines)
+{
+    exportLeafAABBs<D, vec_t, AABB_LINE_VERTICES>(_qt, _out_lines);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getAABBLines(OrthtreeBH *_qt, std::vector<vec_t> &_out_vec_lines)
+{
+    size_t n = _out_vec_lines.size();
+    _out_vec_lines.resize(n + AABB_LINE_VERTICES * (size_t)_qt->m_leafCount);
+    _qt->exportAABBLines(_qt, _out_vec_lines.data() + n);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getAABBs(OrthtreeBH *_qt, std::vector<box_t> &_out_vec_aabbs)
+{
+    size_t n = _out_vec_aabbs.size();
+    _out_vec_aabbs.resize(n + _qt->m_leafCount);
+    _qt->exportAABBs(_qt, _out_vec_aabbs.data() + n);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getVertices(OrthtreeBH *_qt, std::vector<vec_t> &_out_vec_points)
+{
+    size_t n = _out_vec_points.size();
+    _out_vec_points.resize(n + _qt->m_vertexCount);
+    _qt->exportVertices(_qt, _out_vec_points.data() + n);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getVertices(OrthtreeBH *_qt, 
+                                const AABB<D> &_view, 
+                                vec_t *_out_points, 
+                                size_t _max_count, 
+                                size_t &_out_count)
+{
+    struct CulledVertexVisitor : OrthtreeVisitor<D>
+    {
+        CulledVertexVisitor(const AABB<D> &_view, vec_t *_out, size_t _max_count, size_t &_out_count) :
+            view(_view), out(_out), max_count(_max_count), count(_out_count)
+        {}
+
+        bool openNode(OrthtreeBH *_qt)
+        {
+            // skip empty and invisible subtrees
+            if (!_qt->getVertexCount())
+                return false;
+            AABB<D> aabb = _qt->getAABB();
+            if (!view.intersects(aabb))
+                return false;
+            if (!_qt->isLeaf() || !view.contains(aabb))
+                return true;
+            // vertices on the upper edges of the root are kept in the last leaves, but
+            // are outside a (half-open) view ending there
+            for (int d = 0; d < D; d++)
+                if (aabb.v1[d] == view.v1[d])
+                    return true;
+
+            // the whole leaf is visible, no need to test individual vertices
+            Vertices v = _qt->getLocalVertices();
+            size_t n = std::min(v.size(), max_count - count);
+            if (n)
+                memcpy(out + count, v.data, sizeof(vec_t) * n);
+            count += n;
+            return false;
+        }
+        void visitPoint(const vec_t &_v)
+        {
+            if (count < max_count && view.contains(_v))
+                out[count++] = _v;
+        }
+        bool done() { return count == max_count; }
+
+        AABB<D> view;
+        vec_t *out;
+        size_t max_count;
+        size_t &count;
+    } visitor(_view, _out_points, _max_count, _out_count);
+    _qt->traverse(_qt, visitor);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getAABBLines(OrthtreeBH *_qt, 
+                                 const AABB<D> &_view, 
+                                 vec_t *_out_lines, 
+                                 size_t _max_count, 
+                                 size_t &_out_count)
+{
+    LeafAABBVisitor<D, vec_t, AABB_LINE_VERTICES> visitor(&_view, _out_lines, _max_count, _out_count);
+    _qt->traverse(_qt, visitor);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getAABBs(OrthtreeBH *_qt, 
+                             const AABB<D> &_view, 
+                             box_t *_out_aabbs, 
+                             size_t _max_count, 
+                             size_t &_out_count)
+{
+    LeafAABBVisitor<D, box_t, 1> visitor(&_view, _out_aabbs, _max_count, _out_count);
+    _qt->traverse(_qt, visitor);
+}
+
+// Squared length, summed axis by axis (dx * dx + dy * dy in 2D)
+template<int D>
+static inline float length2(const glm::vec<D, float> &_v)
+{
+    float l2 = 0.0f;
+    for (int d = 0; d < D; d++)
+        l2 += _v[d] * _v[d];
+    return l2;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::approxBH(OrthtreeBH *_qt, 
+                             const vec_t &_cmp_vertex, 
+                             std::vector<bh_t> &_out_v_bh)
 {
     // skip empty trees
     if (!_qt->m_vertexCount)
@@ -153,102 +1238,470 @@ void QuadtreeBH::approxBH(QuadtreeBH *_qt,
 
     // TODO : check that we don't compare to itself
 
-    float s = _qt->m_aabb.size();
-    float d = glm::distance(_qt->m_mean, _cmp_vertex);
-    // bool is_close = s / d >= THETA_BH;
-    bool is_close = s / d >= s_thetaBH;
+    bool is_close = _qt->isCloseBH(_cmp_vertex);
 
-    // close with children
-    if (is_close && _qt->m_children[0] != NULL)
-    {
-        for (int i = 0; i < 4; i++)
-            _qt->m_children[i]->approxBH(_qt->m_children[i], _cmp_vertex, _out_v_bh);
-    }
+    // close with children -- these are tested 4 at a time
+    if (is_close && _qt->m_children != NULL)
+        _qt->approxBH4(_qt, _cmp_vertex, _out_v_bh);
     
     // close but without children (leaf node) -- all vertices are relevant
-    else if (is_close && _qt->m_children[0] == NULL)
+    else if (is_close && _qt->m_children == NULL && !_qt->isAggregate())
     {
-        for (auto &v : _qt->m_vertices)
-            _out_v_bh.push_back(glm::vec3(v.x, v.y, 1.0f));
+        for (auto &v : _qt->getLocalVertices())
+            _out_v_bh.push_back(bh_t(v, 1.0f));
     }
     
-    // sufficiently far away
-    else if (!is_close)
-        _out_v_bh.push_back(glm::vec3(_qt->m_mean.x, _qt->m_mean.y, (float)_qt->m_vertexCount));
+    // sufficiently far away (or only an aggregate)
+    else
+    {
+        vec_t mean = _qt->getMean();
+        _out_v_bh.push_back(bh_t(mean, (float)_qt->m_vertexCount));
+    }
 
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::getClosestVertex(QuadtreeBH *_qt, 
-                                  const glm::vec2 &_cmp_vertex, 
-                                  glm::vec2 &_out_closest)
+template<int D>
+void OrthtreeBH<D>::approxBH(OrthtreeBH *_qt, 
+                             const vec_t &_cmp_vertex, 
+                             const BHOpening &_opening,
+                             std::vector<bh_t> &_out_v_bh)
 {
-    float min_dist = 1e14;
-    for (auto &v : _qt->m_vertices)
+    struct ApproxVisitor : OrthtreeBHVisitor<D>
     {
-        float dist = glm::distance(_cmp_vertex, v);
-        if (dist < min_dist)
+        ApproxVisitor(const vec_t &_v, const BHOpening &_opening, std::vector<bh_t> &_out) :
+            OrthtreeBHVisitor<D>(_v, _opening), out(_out)
+        {}
+        void visitNode(OrthtreeBH *_qt)
         {
-            min_dist = dist;
-            _out_closest = v;
+            if (!_qt->getVertexCount())
+                return;
+            vec_t mean = _qt->getMean();
+            out.push_back(bh_t(mean, (float)_qt->getVertexCount()));
+        }
+        void visitPoint(const vec_t &_v) { out.push_back(bh_t(_v, 1.0f)); }
+        std::vector<bh_t> &out;
+    } visitor(_cmp_vertex, _opening, _out_v_bh);
+    _qt->traverse(_qt, visitor);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::approxBH4(OrthtreeBH *_qt, 
+                              const vec_t &_cmp_vertex, 
+                              std::vector<bh_t> &_out_v_bh)
+{
+    float theta2 = s_thetaBH * s_thetaBH;
+#if defined(__SSE2__)
+    __m128 q[D];
+    for (int d = 0; d < D; d++)
+        q[d] = _mm_set1_ps(_cmp_vertex[d]);
+    __m128 t2 = _mm_set1_ps(theta2);
+#endif
+
+    // _qt is an opened internal node; only opened internal nodes are put on the stack,
+    // the far nodes and near leaves are output directly.
+    OrthtreeBH *stack[ORTHTREE_STACK_SIZE(D)];
+    int top = 0;
+    stack[top++] = _qt;
+    while (top)
+    {
+        OrthtreeBH *node = stack[--top];
+        OrthtreeBH *children = node->m_children;
+        int n = node->childCount();
+
+        // The (packed) children are adjacent in memory; gather their aggregates into 
+        // SIMD-friendly arrays, one per axis (unused lanes are never read).
+        alignas(16) float total[D][CHILD_COUNT] = {};
+        alignas(16) float count[CHILD_COUNT] = { 0.0f };
+        alignas(16) float size2[CHILD_COUNT] = { 0.0f };
+        float s = node->m_tree->cellSize(node->getLevel() + 1);
+        for (int i = 0; i < n; i++)
+        {
+            for (int d = 0; d < D; d++)
+                total[d][i] = children[i].m_total[d];
+            count[i] = (float)children[i].m_vertexCount;
+            // (children of compressed trees may be on different levels)
+            float s_i = node->m_tree->compressed ? node->m_tree->cellSize(children[i].getLevel()) : s;
+            size2[i] = s_i * s_i;
+        }
+
+        // Opening criterion (see isCloseBH()) for all children of the opened node, 4 at
+        // a time, giving one bit per child in close_mask.
+        int close_mask = 0;
+    #if defined(__SSE2__)
+        for (int g = 0; g < n; g += 4)
+        {
+            __m128 c = _mm_load_ps(count + g);
+            __m128 d2 = _mm_setzero_ps();
+            for (int d = 0; d < D; d++)
+            {
+                __m128 dd = _mm_sub_ps(_mm_load_ps(total[d] + g), _mm_mul_ps(c, q[d]));
+                d2 = _mm_add_ps(d2, _mm_mul_ps(dd, dd));
+            }
+            __m128 lhs = _mm_mul_ps(_mm_mul_ps(_mm_load_ps(size2 + g), c), c);
+            __m128 rhs = _mm_mul_ps(t2, d2);
+            close_mask |= _mm_movemask_ps(_mm_cmpge_ps(lhs, rhs)) << g;
+        }
+    #else
+        for (int i = 0; i < n; i++)
+        {
+            float d2 = 0.0f;
+            for (int d = 0; d < D; d++)
+            {
+                float dd = total[d][i] - count[i] * _cmp_vertex[d];
+                d2 += dd * dd;
+            }
+            close_mask |= (size2[i] * count[i] * count[i] >= theta2 * d2) << i;
+        }
+    #endif
+
+        // (child nodes are never empty)
+        for (int i = 0; i < n; i++)
+        {
+            OrthtreeBH *child = &children[i];
+            
+            // sufficiently far away (or only an aggregate)
+            if (!(close_mask & (1 << i)) || child->isAggregate())
+            {
+                vec_t mean = child->getMean();
+                _out_v_bh.push_back(bh_t(mean, count[i]));
+            }
+
+            // close with children
+            else if (child->m_children != NULL)
+                stack[top++] = child;
+
+            // close leaf node -- all vertices are relevant
+            else
+            {
+                for (auto &v : child->getLocalVertices())
+                    _out_v_bh.push_back(bh_t(v, 1.0f));
+            }
         }
     }
 }
 
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::getSelectedAABB(QuadtreeBH *_qt, const glm::vec2 _v, AABB2 &_out_aabb)
+template<int D>
+bool OrthtreeBH<D>::isCloseBH(const vec_t &_cmp_vertex, float _theta)
 {
-    if (!_qt->m_aabb.contains(_v))
-        return;
+    // s / d >= theta, with d = |total / count - v|, multiplied by count and squared to 
+    // avoid divisions and the sqrt (and with d = 0 still giving 'close', as s / 0 = inf)
+    float s = m_tree->cellSize(getLevel());
+    float c = (float)m_vertexCount;
+    float d2 = length2(m_total - c * _cmp_vertex);
+    float s2 = s * s;
+    return s2 * c * c >= _theta * _theta * d2;
+}
 
-    // no children and contained here
-    else if (_qt->m_children[0] == NULL)
-        _out_aabb = _qt->m_aabb;
+//---------------------------------------------------------------------------------------
+template<int D>
+bool OrthtreeBH<D>::isCloseBH(const vec_t &_cmp_vertex, const BHOpening &_opening)
+{
+    switch (_opening.criterion)
+    {
+        case BH_CRITERION_BMAX:
+        {
+            // bmax: largest distance from the mean to a corner of the box, bounding the 
+            // error of the mean regardless of where it is inside the box; d_min: distance 
+            // from the query to the box (0 inside)
+            AABB<D> aabb = getAABB();
+            vec_t mean = getMean();
+            vec_t b = glm::max(mean - aabb.v0, aabb.v1 - mean);
+            vec_t d = glm::max(glm::max(aabb.v0 - _cmp_vertex, _cmp_vertex - aabb.v1), vec_t(0.0f));
+            float bmax2 = length2(b);
+            float dmin2 = length2(d);
+            return bmax2 >= _opening.theta * _opening.theta * dmin2;
+        }
 
-    // interrogate children
-    else
+        case BH_CRITERION_RELATIVE:
+        {
+            if (_opening.accel <= 0.0f)
+                return isCloseBH(_cmp_vertex, _opening.theta);
+
+            AABB<D> aabb = getAABB();
+            bool inside = true;
+            for (int d = 0; d < D; d++)
+                inside &= (_cmp_vertex[d] >= aabb.v0[d] && _cmp_vertex[d] <= aabb.v1[d]);
+            if (inside)
+                return true;
+
+            // N s^2 / d^4 > alpha |a|
+            float s = m_tree->cellSize(getLevel());
+            vec_t d = getMean() - _cmp_vertex;
+            float d2 = length2(d);
+            return (float)m_vertexCount * s * s > _opening.alpha * _opening.accel * d2 * d2;
+        }
+
+        default:
+            return isCloseBH(_cmp_vertex, _opening.theta);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+static inline glm::vec<D, float> softenedGravity(const glm::vec<D, float> &_d, float _mass, float _eps2)
+{
+    float r2 = length2(_d) + _eps2;
+    float inv_r = 1.0f / sqrtf(r2);
+    return _d * (_mass * inv_r * inv_r * inv_r);
+}
+
+//
+template<int D>
+struct AccelerationVisitor : OrthtreeBHVisitor<D>
+{
+    typedef glm::vec<D, float> vec_t;
+
+    AccelerationVisitor(const vec_t &_v, const BHOpening &_opening, float _eps2) :
+        OrthtreeBHVisitor<D>(_v, _opening), eps2(_eps2)
+    {}
+
+    // far node (or only an aggregate)
+    void visitNode(OrthtreeBH<D> *_qt)
     {
-        for (int i = 0; i < 4; i++)
-            _qt->getSelectedAABB(_qt->m_children[i], _v, _out_aabb);
+        if (_qt->getVertexCount())
+            a += softenedGravity(_qt->getMean() - this->query, (float)_qt->getVertexCount(), eps2);
     }
-    
+
+    // vertex of a close leaf (the query itself contributes nothing, as d = 0)
+    void visitPoint(const vec_t &_w) { a += softenedGravity(_w - this->query, 1.0f, eps2); }
+
+    float eps2;
+    vec_t a = vec_t(0.0f);
+};
+
+//---------------------------------------------------------------------------------------
+template<int D>
+typename OrthtreeBH<D>::vec_t OrthtreeBH<D>::accelerationBH(OrthtreeBH *_qt, 
+                                                            const vec_t &_v, 
+                                                            const BHOpening &_opening, 
+                                                            float _softening)
+{
+    AccelerationVisitor<D> visitor(_v, _opening, _softening * _softening);
+    _qt->traverse(_qt, visitor);
+    return visitor.a;
 }
 
+//
+template<int D>
+struct RepulsionVisitor : OrthtreeBHVisitor<D>
+{
+    typedef glm::vec<D, float> vec_t;
+
+    RepulsionVisitor(const vec_t &_v, float _theta) :
+        OrthtreeBHVisitor<D>(_v, BHOpening(_theta))
+    {}
+
+    void visitNode(OrthtreeBH<D> *_qt)
+    {
+        if (!_qt->getVertexCount())
+            return;
+        vec_t mean = _qt->getMean();
+        uint32_t count = _qt->getVertexCount();
+        // the query vertex is in the aggregate of a node on its path: remove it
+        if (self && std::find(path, path + pathLength, _qt) != path + pathLength)
+        {
+            self = false;
+            if (!--count)
+                return;
+            mean = (_qt->getTotal() - this->query) / (float)count;
+        }
+        vec_t d = this->query - mean;
+        float n = (float)count;
+        float q = 1.0f / (1.0f + length2(d));
+        z += n * q;
+        f += d * (n * q * q);
+    }
+
+    void visitPoint(const vec_t &_w)
+    {
+        // (only the first copy of the query vertex is itself)
+        if (self && _w == this->query)
+        {
+            self = false;
+            return;
+        }
+        vec_t d = this->query - _w;
+        float q = 1.0f / (1.0f + length2(d));
+        z += q;
+        f += d * (q * q);
+    }
+
+    vec_t f = vec_t(0.0f);
+    float z = 0.0f;
+    // self-interaction still to be excluded, and the nodes holding the query vertex
+    bool self = false;
+    OrthtreeBH<D> *path[ORTHTREE_MAX_DEPTH_COMPRESSED(D) + 1];
+    int pathLength = 0;
+};
+
 //---------------------------------------------------------------------------------------
-void QuadtreeBH::getSelectedSubtree(QuadtreeBH *_qt, 
-                                    const glm::vec2& _v, 
-                                    QuadtreeBH **_out_qt)
+template<int D>
+float OrthtreeBH<D>::repulsionBH(OrthtreeBH *_qt, 
+                                 const vec_t &_v, 
+                                 float _theta, 
+                                 vec_t &_out_force,
+                                 bool _is_vertex)
 {
-    if (!_qt->m_aabb.contains(_v))
-        return;
+    RepulsionVisitor<D> visitor(_v, _theta);
 
-    // no children and contained here
-    else if (_qt->m_children[0] == NULL)
-        *_out_qt = _qt;
+    // the path of _v from _qt down to its leaf, as taken by insert()
+    visitor.self = _is_vertex;
+    for (OrthtreeBH *node = _qt; _is_vertex && node != NULL; )
+    {
+        visitor.path[visitor.pathLength++] = node;
+        node = node->m_children ? node->getChild(node->getChildIndex(node, _v)) : NULL;
+    }
 
-    // interrogate children
-    else
+    _qt->traverse(_qt, visitor);
+    _out_force = visitor.f;
+    return visitor.z;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getClosestVertex(OrthtreeBH *_qt, 
+                                     const vec_t &_cmp_vertex, 
+                                     vec_t &_out_closest)
+{
+    float min_dist = 1e14;
+    for (auto &v : _qt->getLocalVertices())
     {
-        for (int i = 0; i < 4; i++)
-            _qt->getSelectedSubtree(_qt->m_children[i], _v, _out_qt);
+        float dist = glm::distance(_cmp_vertex, v);
+        if (dist < min_dist)
+        {
+            min_dist = dist;
+            _out_closest = v;
+        }
     }
 }
 
 //---------------------------------------------------------------------------------------
-uint32_t QuadtreeBH::depth(QuadtreeBH *_qt)
+template<int D>
+void OrthtreeBH<D>::getSelectedAABB(OrthtreeBH *_qt, const vec_t _v, AABB<D> &_out_aabb)
 {
-    if (_qt->m_children[0] != NULL)
+    OrthtreeBH *node = NULL;
+    getSelectedSubtree(_qt, _v, &node);
+    if (node != NULL)
+        _out_aabb = node->getAABB();
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeBH<D>::getSelectedSubtree(OrthtreeBH *_qt, 
+                                       const vec_t& _v, 
+                                       OrthtreeBH **_out_qt)
+{
+    // NULL over empty quadrants: the previous selection may have been freed by an insert
+    *_out_qt = _qt->getLeaf(_qt, _v);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+OrthtreeBH<D> *OrthtreeBH<D>::getLeaf(OrthtreeBH *_qt, const vec_t &_v)
+{
+    // the root is closed at its upper bounds, as all cells below (see below)
+    AABB<D> root = _qt->getAABB();
+    for (int d = 0; d < D; d++)
+        if (_v[d] < root.v0[d] || _v[d] > root.v1[d])
+            return NULL;
+
+    // Compressed trees skip levels, so that ancestors aren't found by location code; 
+    // descend instead (bounded by the node depth), checking that compressed children 
+    // actually hold _v.
+    if (_qt->m_tree->compressed)
     {
-        uint32_t d = 0;
-        for (int i = 0; i < 4; i++)
-            d = std::max(d, _qt->depth(_qt->m_children[i]));
-        return std::max(d, _qt->m_level);
+        OrthtreeBH *node = _qt;
+        while (node != NULL && node->m_children != NULL)
+        {
+            OrthtreeBH *child = node->getChild(node->getChildIndex(node, _v));
+            if (child != NULL && child->m_key != node->descendKey(node, _v, child->getLevel()))
+                return NULL;
+            node = child;
+        }
+        return node;
+    }
+
+    // Cell coordinates at MAX_LEVEL resolution. Cells are closed at the upper bound, as 
+    // in getChildIndex() where a vertex on a midpoint goes to the lower child (or exact,
+    // from the fixed-point coordinates, in quantized mode).
+    cell_t cell;
+    bool quantized = _qt->m_tree->quantized;
+    if (quantized)
+    {
+        cell_t q = _qt->m_tree->quantize(_v);
+        for (int d = 0; d < D; d++)
+            cell[d] = q[d] >> (32 - MAX_LEVEL);
     }
-    // leaf node
     else
-        return _qt->m_level;
+    {
+        const uint32_t n = 1u << MAX_LEVEL;
+        vec_t t = (_v - root.v0) / (root.v1 - root.v0) * (float)n;
+        for (int d = 0; d < D; d++)
+            cell[d] = (uint32_t)std::min(std::max((int)ceilf(t[d]) - 1, 0), (int)n - 1);
+    }
 
-}
+    // Binary search over the levels for the deepest existing node on the path of _v; 
+    // if a node exists, so do all its ancestors.
+    OrthtreeBH *leaf = _qt;
+    uint32_t lo = 1, hi = MAX_LEVEL;
+    while (lo <= hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        OrthtreeBH *node = _qt->m_tree->index.find(OrthtreeIndex<D>::levelKey(cell, mid));
+        if (node != NULL)
+        {
+            leaf = node;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
 
+    // The quantization above may round differently from the midpoints used by insert(),
+    // but only for vertices on (or within float precision of) the boundary of the leaf.
+    // For vertices strictly inside the leaf, all ancestors agree on the path.
+    if (quantized)
+        return leaf->m_children == NULL ? leaf : NULL;
+    AABB<D> aabb = leaf->getAABB();
+    bool inside = (leaf->m_children == NULL);
+    for (int d = 0; d < D; d++)
+        inside &= (_v[d] > aabb.v0[d] && _v[d] < aabb.v1[d]);
+    if (inside)
+        return leaf;
 
+    // fall back to descending the tree
+    leaf = _qt;
+    while (leaf != NULL && leaf->m_children != NULL)
+        leaf = leaf->getChild(leaf->getChildIndex(leaf, _v));
+    return leaf;
+}
 
+//---------------------------------------------------------------------------------------
+template<int D>
+uint32_t OrthtreeBH<D>::depth(OrthtreeBH *_qt)
+{
+    // deepest leaf node, in nodes below _qt (the level of the deepest leaf, unless the 
+    // tree is compressed)
+    struct Entry { OrthtreeBH *node; uint32_t depth; };
+    Entry stack[ORTHTREE_STACK_SIZE(D)];
+    int top = 0;
+    stack[top++] = { _qt, 0 };
+    uint32_t d = 0;
+    while (top)
+    {
+        Entry e = stack[--top];
+        d = std::max(d, e.depth);
+        for (int i = 0; i < e.node->childCount(); i++)
+            stack[top++] = { &e.node->m_children[i], e.depth + 1 };
+    }
+    return d;
+}
+
+//---------------------------------------------------------------------------------------
+template class OrthtreeLeafSlab<2>;
+template class OrthtreeLeafSlab<3>;
+template class OrthtreeBH<2>;
+template class OrthtreeBH<3>;
@@ -3,38 +3,127 @@
 
 
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <stdint.h>
 #include <glm/glm.hpp>
+#include <synapse/Debug>
+
+#include "quadtree_index.h"
 
 #define MAX_DEPTH               12
+// compressed trees don't grow chains of nodes, and may use all levels of a 32-bit 
+// location code
+#define MAX_DEPTH_COMPRESSED    15
+// The same for OrthtreeBH<_D>: the location code of a node at the deepest level has to
+// fit in 32 bits (D bits per level and the sentinel)
+#define ORTHTREE_MAX_DEPTH(_D)              ((_D) == 2 ? MAX_DEPTH : 31 / (_D))
+#define ORTHTREE_MAX_DEPTH_COMPRESSED(_D)   ((_D) == 2 ? MAX_DEPTH_COMPRESSED : 31 / (_D))
 #define MAX_VERTICES_PER_NODE   8
 #define THETA_BH                1.0f    // ratio aabb size and between distance
+#define INSERT_LOG_SIZE         256     // inserts remembered for incremental consumers
+// A depth-first traversal leaves at most 2^D - 1 unvisited siblings per level on the stack
+#define ORTHTREE_STACK_SIZE(_D) (((1 << (_D)) - 1) * ORTHTREE_MAX_DEPTH_COMPRESSED(_D) + (1 << (_D)))
+#define TRAVERSAL_STACK_SIZE    ORTHTREE_STACK_SIZE(2)
+#define LEAF_SLAB_CHUNK_BLOCKS  4096    // leaf blocks allocated at once by QuadtreeLeafSlab
+// Leaves per tree (28-bit leaf counts in 2D, 24-bit in 3D, next to the 2^D bit child 
+// mask); an insert adds at most 2^D - 1 leaves (a full leaf replaced by up to 2^D), 
+// inserts that could exceed this are discarded
+#define ORTHTREE_MAX_LEAF_COUNT(_D)     ((1u << (32 - (1 << (_D)))) - 1)
+#define MAX_LEAF_COUNT          ORTHTREE_MAX_LEAF_COUNT(2)
+// batches of at least this many vertices fill the subtrees below the top levels of the 
+// tree concurrently (see QuadtreeBH::insertParallel())
+#define INSERT_PARALLEL_MIN     65536
+
+extern float s_thetaBH;
+
+// Opening criteria for the Barnes-Hut approximation (see BHOpening)
+enum BHCriterion
+{
+    BH_CRITERION_GEOMETRIC = 0, // s / d >= theta, d = distance to the node mean
+    BH_CRITERION_BMAX,          // bmax / theta >= d_min, d_min = distance to the node box
+    BH_CRITERION_RELATIVE,      // estimated force error >= alpha * |a| (GADGET style)
+};
 
 //
-struct AABB2
+struct BHOpening
+{
+    BHOpening() {}
+    BHOpening(float _theta) : 
+        theta(_theta) 
+    {}
+    BHOpening(BHCriterion _criterion, float _theta, float _alpha=0.005f, float _accel=0.0f) :
+        criterion(_criterion), theta(_theta), alpha(_alpha), accel(_accel)
+    {}
+
+    BHCriterion criterion = BH_CRITERION_GEOMETRIC;
+    float theta = THETA_BH;     // opening angle (geometric and bmax criteria)
+    // Relative criterion: a node of N vertices, size s, at distance d is opened if
+    // N s^2 / d^4 > alpha |a|, where |a| is the magnitude of the acceleration (per unit
+    // mass, as accelerationBH()) at the query vertex, e.g. from the previous time step.
+    // Nodes containing the query vertex are always opened. Falls back to the geometric
+    // criterion while accel is 0.
+    float alpha = 0.005f;
+    float accel = 0.0f;
+};
+
+/* Axis-aligned box in D dimensions; AABB2 for the quadtree and AABB3 for the octree.
+ * Contains points half-open (lower bounds inclusive), and other boxes closed.
+ */
+template<int D>
+struct AABB
 {
+    typedef glm::vec<D, float> vec_t;
+
     //
-    AABB2() :
-        v0({ -1.0f, -1.0f }), v1({ 1.0f, 1.0f })
+    AABB() :
+        v0(vec_t(-1.0f)), v1(vec_t(1.0f))
     {}
     
-    AABB2(const glm::vec2 &_v0, const glm::vec2 &_v1) :
+    AABB(const vec_t &_v0, const vec_t &_v1) :
         v0(_v0), v1(_v1)
     {}
 
-    AABB2(float _x0, float _x1, float _y0, float _y1) :
-        v0(glm::vec2(_x0, _y0)), v1(glm::vec2(_x1, _y1))
+    // (2D)
+    template<int _D=D, typename=typename std::enable_if<_D == 2>::type>
+    AABB(float _x0, float _x1, float _y0, float _y1) :
+        v0(vec_t(_x0, _y0)), v1(vec_t(_x1, _y1))
     {}
 
     //
-    bool contains(const glm::vec2 &_v)
+    bool contains(const vec_t &_v) const
+    {
+        for (int d = 0; d < D; d++)
+            if (!(_v[d] >= v0[d] && _v[d] < v1[d]))
+                return false;
+        return true;
+    }
+
+    // true if _aabb lies completely inside this AABB
+    bool contains(const AABB &_aabb) const
+    {
+        for (int d = 0; d < D; d++)
+            if (!(_aabb.v0[d] >= v0[d] && _aabb.v1[d] <= v1[d]))
+                return false;
+        return true;
+    }
+
+    // true if the AABBs overlap (touching edges count as overlapping)
+    bool intersects(const AABB &_aabb) const
     {
-        return (_v.x >= v0.x && _v.x < v1.x && 
-                _v.y >= v0.y && _v.y < v1.y);
+        for (int d = 0; d < D; d++)
+            if (!(_aabb.v0[d] <= v1[d] && _aabb.v1[d] >= v0[d]))
+                return false;
+        return true;
     }
 
+    bool operator==(const AABB &_aabb) const { return (v0 == _aabb.v0 && v1 == _aabb.v1); }
+    bool operator!=(const AABB &_aabb) const { return !(*this == _aabb); }
+
     //
-    glm::vec2 midpoint() { return glm::vec2(v0 + ((v1 - v0) * 0.5f)); }
-    const float size() { return (v1.x - v0.x); }
+    vec_t midpoint() const { return vec_t(v0 + ((v1 - v0) * 0.5f)); }
+    float size() const { return (v1[0] - v0[0]); }
 
     //
     void __debug_print(const char *_id) const
@@ -44,133 +133,781 @@ struct AABB2
     }
 
     //
-    glm::vec2 v0;
-    glm::vec2 v1;
+    vec_t v0;
+    vec_t v1;
+
+};
+
+typedef AABB<2> AABB2;
+typedef AABB<3> AABB3;
+
+
+// Construction flags of QuadtreeBH (see QuadtreeBH), combined with |. A distinct type,
+// so that integers (e.g. a level) aren't taken for flags.
+enum QuadtreeFlags
+{
+    QUADTREE_DEFAULT    = 0,
+    QUADTREE_COMPRESSED = 1 << 0,   // collapse single-child chains, bucket duplicates
+    QUADTREE_QUANTIZED  = 1 << 1,   // descend on 32-bit fixed-point coordinates
+};
+
+inline QuadtreeFlags operator|(QuadtreeFlags _a, QuadtreeFlags _b)
+{ return (QuadtreeFlags)((uint32_t)_a | (uint32_t)_b); }
+
+// Memory layouts for QuadtreeBH::compact()
+enum QuadtreeLayout
+{
+    QUADTREE_LAYOUT_DFS = 0,    // depth-first (pre-order) -- the traversal order
+    QUADTREE_LAYOUT_BFS,        // breadth-first, level by level
+    QUADTREE_LAYOUT_VEB,        // van Emde Boas: recursively, top half of the levels first
+};
+
+/* Slab allocator for leaf storage: fixed-size blocks of MAX_VERTICES_PER_NODE vertices,
+ * carved from large chunks that are never moved or freed before the tree, with released
+ * blocks kept on an intrusive free list. Only one in LEAF_SLAB_CHUNK_BLOCKS allocations
+ * touches the heap.
+ */
+template<int D>
+class OrthtreeLeafSlab
+{
+public:
+    typedef glm::vec<D, float> vec_t;
+
+public:
+    OrthtreeLeafSlab() = default;
+    ~OrthtreeLeafSlab();
+    OrthtreeLeafSlab(const OrthtreeLeafSlab &) = delete;
+    OrthtreeLeafSlab &operator=(const OrthtreeLeafSlab &) = delete;
+
+    vec_t *alloc();
+    void release(vec_t *_block);
+    size_t memoryUsage() const { return m_blockCount * sizeof(Block); }
+    // Takes over the chunks and free blocks of _other (e.g. a slab used by another 
+    // thread while filling a subtree), leaving it empty
+    void adopt(OrthtreeLeafSlab &_other);
+
+    // Replaces all storage by one chunk of _blocks blocks, all in use, returned as 
+    // contiguous vertices (block i starting at vertex i * MAX_VERTICES_PER_NODE). The 
+    // previous chunks are moved to _out_old; free() them once their contents are copied.
+    vec_t *compact(size_t _blocks, std::vector<void *> &_out_old);
+
+
+private:
+    union Block
+    {
+        float vertices[D * MAX_VERTICES_PER_NODE];
+        Block *next;    // when on the free list
+    };
+
+    std::vector<Block *> m_chunks;
+    size_t m_blockCount = 0;    // in all chunks
+    Block *m_free = NULL;
+    size_t m_chunkUsed = LEAF_SLAB_CHUNK_BLOCKS;    // blocks handed out from the last chunk
 
 };
 
+typedef OrthtreeLeafSlab<2> QuadtreeLeafSlab;
 
-/* QuadtreeBH used for Barnes-Hut approximation. Inherits the base class. All sub-trees 
+
+/* State shared by all nodes of a tree, owned by the root. Only the root stores its
+ * bounds; the bounds of all other nodes are implicit from their location code (level 
+ * and Morton path, see OrthtreeIndex).
+ */
+template<int D>
+struct OrthtreeState
+{
+    typedef glm::vec<D, float> vec_t;
+    typedef glm::vec<D, uint32_t> cell_t;
+
+    OrthtreeState(size_t _max_vertices, const AABB<D> &_aabb, QuadtreeFlags _flags) :
+        aabb(_aabb), maxVertices(_max_vertices), 
+        compressed(_flags & QUADTREE_COMPRESSED), quantized(_flags & QUADTREE_QUANTIZED),
+        maxDepth(compressed ? ORTHTREE_MAX_DEPTH_COMPRESSED(D) : ORTHTREE_MAX_DEPTH(D))
+    {
+        for (int d = 0; d < D; d++)
+            quantScale[d] = 4294967296.0 / ((double)_aabb.v1[d] - (double)_aabb.v0[d]);
+    }
+
+    // Lower corner of cell _cell at _level. Since scaling by powers of two is exact,
+    // cellMin(_level + 1, 2 * _cell) == cellMin(_level, _cell), i.e. nodes on different 
+    // levels agree exactly on shared boundaries.
+    vec_t cellMin(uint32_t _level, const cell_t &_cell) const
+    {
+        vec_t cell_size = (aabb.v1 - aabb.v0) * (1.0f / (float)(1u << _level));
+        return aabb.v0 + vec_t(_cell) * cell_size;
+    }
+
+    // (x-axis) size of the nodes at _level
+    float cellSize(uint32_t _level) const
+    { return (aabb.v1[0] - aabb.v0[0]) * (1.0f / (float)(1u << _level)); }
+
+    // Quantized mode: _v as 32-bit fixed point relative to the root (clamped to it), so
+    // that bit 31 - level of each coordinate selects the child quadrant of a node at 
+    // level (see quadrant()). Cells are half-open, as AABB::contains().
+    cell_t quantize(const vec_t &_v) const
+    {
+        cell_t q;
+        for (int d = 0; d < D; d++)
+        {
+            double x = ((double)_v[d] - (double)aabb.v0[d]) * quantScale[d];
+            q[d] = (uint32_t)std::min(std::max(x, 0.0), 4294967295.0);
+        }
+        return q;
+    }
+
+    // child quadrant (octant) of the node at _level on the path of the quantized vertex _q
+    static uint8_t quadrant(const cell_t &_q, uint32_t _level)
+    {
+        uint8_t idx = 0;
+        for (int d = 0; d < D; d++)
+            idx |= ((_q[d] >> (31 - _level)) & 1) << d;
+        return idx;
+    }
+
+    AABB<D> aabb;
+    size_t maxVertices;
+    bool compressed;    // see OrthtreeBH
+    bool quantized;     // see OrthtreeBH
+    uint32_t maxDepth;  // level of the smallest (unsplittable) leaves
+    double quantScale[D];   // fixed-point units per unit of each axis
+    OrthtreeIndex<D> index;
+    OrthtreeLeafSlab<D> leaves;
+    
+    // incremented whenever nodes are moved in memory, invalidating node pointers
+    uint64_t relocations = 0;
+
+    // Node pool of the last compaction (see OrthtreeBH::compact()): holds the child 
+    // arrays of all nodes at the time, which are never freed individually.
+    void *nodePool = NULL;
+    size_t nodePoolBytes = 0;
+    bool inNodePool(const void *_p) const
+    { return (const char *)_p >= (const char *)nodePool && (const char *)_p < (const char *)nodePool + nodePoolBytes; }
+
+    // Insert journal: insertLog holds the vertices inserted since version 
+    // insertLogVersion, so that consumers can repair derived data incrementally.
+    uint64_t version = 0;
+    uint64_t insertLogVersion = 0;
+    std::vector<vec_t> insertLog;
+
+};
+
+typedef OrthtreeState<2> QuadtreeState;
+
+template<int D> class OrthtreeTraversal;
+
+
+/* Tree used for Barnes-Hut approximation, over points in D = 2 (QuadtreeBH) or D = 3 
+ * (OctreeBH) dimensions; all of the below applies to both, with 2^D children per node
+ * (quadrants or octants), found with one comparison (or bit) per axis. All sub-trees 
  * store the following:
  *  1. number of points in children (i.e. keeps track of all points 'flowing' through this node).
- *  2. a average vector of all points in this and all children of the current node, updated
- *     with every incoming point.
+ *  2. the sum of all points in this and all children of the current node, updated with 
+ *     every incoming point (the mean is computed from this on demand).
  * This approach is made possible through the assumption that all nodes have the same mass,
  * and thus is not subject to weighting.
+ *
+ * Nodes are stored compactly: only non-empty quadrants have child nodes, packed 
+ * contiguously in m_children in quadrant order, with m_childMask telling which quadrants
+ * are present. Bounds and level are derived from the location code m_key. A node is 48
+ * bytes in 2D (112 before); on the __debug_setup_BH_test distribution, total memory per
+ * node (see memoryUsage()) went from 170.4 to 120.8 bytes, about 29% less rather than
+ * half: of the 120.8, 48.5 are leaf storage (fixed blocks of MAX_VERTICES_PER_NODE,
+ * with ~3.7 vertices per leaf) and 24.3 the key index, neither part of the node. Moving
+ * m_total and m_vertexCount of leaves to a side array would save at most ~9 bytes/node,
+ * for an extra indirection per leaf visited by Barnes-Hut queries.
+ *
+ * In compressed mode, chains of nodes with a single child are collapsed: a node is 
+ * shrunk to the deepest cell holding all of its vertices (so that children may be 
+ * several levels below their parent), and is only split where its vertices diverge. 
+ * Vertices that share a cell at MAX_DEPTH_COMPRESSED (e.g. duplicates) are kept in one 
+ * bucket leaf instead. The number of nodes, and the depth in nodes, thus follow the 
+ * number of vertices rather than the coordinate precision. Not supported by 
+ * insertAggregate().
+ *
+ * In quantized mode, vertices are converted once per insert (or point location) to 
+ * 32-bit fixed-point coordinates relative to the root, and descend by extracting one bit
+ * per level and axis instead of comparing against float midpoints. Subdivision is thus
+ * exact: a vertex is in the cell whose integer range holds its fixed-point coordinates,
+ * with no rounding differences between levels, and on midpoints it goes to the upper 
+ * child (half-open cells, as AABB::contains()) rather than the lower. The structure of
+ * the tree only depends on the set of vertices, so it is reproducible across machines
+ * and insertion orders (node sums still depend on the order of float additions).
+ * Combines with compressed mode.
  */
-class QuadtreeBH
+template<int D>
+class OrthtreeBH
 {
 public:
     friend class BHRenderer;
+    friend class BHInteractionCache;
+    friend class OrthtreeTraversal<D>;
+    friend class QuadtreeShard;
+
+    static constexpr uint32_t CHILD_COUNT = 1u << D;
+    // level of the smallest leaves of regular (not compressed) trees, see MAX_DEPTH
+    static constexpr uint32_t MAX_LEVEL = ORTHTREE_MAX_DEPTH(D);
+    // vertices per leaf exported by exportAABBLines(), two per box edge (8 in 2D)
+    static constexpr uint32_t AABB_LINE_VERTICES = D << D;
+
+    typedef glm::vec<D, float> vec_t;
+    typedef glm::vec<D, uint32_t> cell_t;
+    // mean and count of a node for approxBH() (glm::vec3 in 2D, for shader packing)
+    typedef glm::vec<D + 1, float> bh_t;
+    // leaf box written by exportAABBs(): a glm::vec4 in 2D (see getAABBs()), the AABB
+    // otherwise
+    typedef typename std::conditional<D == 2, glm::vec4, AABB<D>>::type box_t;
+
+    // Vertices stored in a leaf
+    struct Vertices
+    {
+        const vec_t *begin() const { return data; }
+        const vec_t *end() const { return data + count; }
+        size_t size() const { return count; }
+        const vec_t *data;
+        size_t count;
+    };
 
 public:
-    QuadtreeBH(size_t _max_vertices, const AABB2 &_aabb=AABB2(), uint32_t _level=0);
-    ~QuadtreeBH() = default;
-
-    void destroy(QuadtreeBH *_qt);
-    void insert(QuadtreeBH *_qt, const glm::vec2 &_v);
-    uint32_t depth(QuadtreeBH *_qt);
+    OrthtreeBH(size_t _max_vertices, 
+               const AABB<D> &_aabb=AABB<D>(), 
+               QuadtreeFlags _flags=QUADTREE_DEFAULT);
+    ~OrthtreeBH();
+
+    void destroy(OrthtreeBH *_qt);
+    void insert(OrthtreeBH *_qt, const vec_t &_v);
+    // Batch insert, with the same result as inserting the vertices one by one: they are
+    // sorted by location code and merged into the tree in one pass, updating the count 
+    // and sum of every touched node once and splitting each overflowing leaf once. 
+    // Batches of INSERT_PARALLEL_MIN vertices or more are keyed, sorted and merged in 
+    // parallel. (In compressed mode the sorted vertices are inserted one by one.)
+    void insert(OrthtreeBH *_qt, const vec_t *_v, size_t _count);
+    // Adds an aggregate-only leaf (the count and sum of vertices, without the vertices 
+    // themselves) at location code _key, creating the path from the root _qt. Used for 
+    // coarse snapshots (see QuadtreeAsyncBuild); the path must not pass through leaves 
+    // holding vertices, and vertices shouldn't be inserted into such a tree.
+    void insertAggregate(OrthtreeBH *_qt, uint32_t _key, const vec_t &_total, uint32_t _count);
+    uint32_t depth(OrthtreeBH *_qt);
+
+    // Number of nodes and total bytes used by the tree (nodes, leaf storage and index)
+    size_t nodeCount(OrthtreeBH *_qt);
+    size_t memoryUsage(OrthtreeBH *_qt);
+
+    // Relocates all nodes (except the root) into one contiguous pool, sibling groups 
+    // ordered by _layout, and the leaf vertices into one contiguous slab chunk in the 
+    // same order. Must be called on the root; invalidates node pointers (as any 
+    // relocation). The tree can still grow afterwards, but child arrays replaced by 
+    // later inserts stay allocated in the pool until the tree is destroyed.
+    void compact(OrthtreeBH *_qt, QuadtreeLayout _layout=QUADTREE_LAYOUT_DFS);
+
+    // Depth-first traversal of _qt with a visitor (see OrthtreeVisitor); the hooks are
+    // resolved at compile time and inlined. All queries below are built on this.
+    template<typename V>
+    void traverse(OrthtreeBH *_qt, V &_visitor);
 
 
     // Accessors ------------------------------------------------------------------------
-    const AABB2 &getAABB() { return m_aabb; }
-    const std::vector<glm::vec2> &getLocalVertices() { return m_vertices; }
-    const uint32_t &getLevel() { return m_level; }
-
-    // Get a vector of all vertices and AABBs, respectively
-    void getVertices(QuadtreeBH *_qt, std::vector<glm::vec2> &_out_vec_points);
-    void getAABBLines(QuadtreeBH *_qt, std::vector<glm::vec2> &_out_vec_lines);
+    AABB<D> getAABB();
+    Vertices getLocalVertices() { return { m_vertices, m_localCount }; }
+    uint32_t getLevel() { return OrthtreeIndex<D>::level(m_key); }
+    vec_t getMean() { return m_total / (float)m_vertexCount; }
+    vec_t getTotal() { return m_total; }
+    uint32_t getVertexCount() { return m_vertexCount; }
+    // number of leaves in the subtree, i.e. of AABBs exported by getAABBs()
+    uint32_t getLeafCount() { return m_leafCount; }
+    bool isLeaf() { return m_children == NULL; }
+    // packed child nodes, in quadrant order (NULL for leaves)
+    OrthtreeBH *getChildren() { return m_children; }
+    int getChildCount() { return childCount(); }
+    // leaf holding only the aggregate of its vertices (see insertAggregate()); treated 
+    // as far by all Barnes-Hut walks
+    bool isAggregate() { return m_children == NULL && m_localCount < m_vertexCount; }
+    size_t getMaxVertices() { return m_tree->maxVertices; }
+    bool isCompressed() { return m_tree->compressed; }
+    bool isQuantized() { return m_tree->quantized; }
+    // incremented for every vertex inserted into the tree
+    uint64_t getVersion() { return m_tree->version; }
+
+    /* Parallel export of all vertices and leaf AABBs (one box_t or AABB_LINE_VERTICES 
+     * line vertices per leaf, as below), in depth-first order, into caller-provided 
+     * buffers such as mapped GPU buffers or mmap'd files, of at least getVertexCount() 
+     * and getLeafCount() (times AABB_LINE_VERTICES for lines) elements, respectively. The tree is split into subtrees that 
+     * are written concurrently, each at the offset given by the prefix sum of the 
+     * vertex/leaf counts of the subtrees before it. Aggregate-only leaves export their 
+     * mean for each of their vertices.
+     */
+    void exportVertices(OrthtreeBH *_qt, vec_t *_out_points);
+    void exportAABBs(OrthtreeBH *_qt, box_t *_out_aabbs);
+    void exportAABBLines(OrthtreeBH *_qt, vec_t *_out_lines);
+
+    // Get a vector of all vertices and AABBs, respectively (appended, through the 
+    // exports above)
+    void getVertices(OrthtreeBH *_qt, std::vector<vec_t> &_out_vec_points);
+    void getAABBLines(OrthtreeBH *_qt, std::vector<vec_t> &_out_vec_lines);
+
+    // One vec4 per leaf (2D), .xy is the AABB min and .zw the AABB max corner (to be 
+    // expanded into box outlines through instanced rendering).
+    void getAABBs(OrthtreeBH *_qt, std::vector<box_t> &_out_vec_aabbs);
+
+    // View-frustum culled versions of the above: subtrees completely outside _view are
+    // skipped and the result is written to a preallocated buffer of _max_count elements,
+    // starting at _out_count (which is advanced). Nothing is written past _max_count.
+    void getVertices(OrthtreeBH *_qt, 
+                     const AABB<D> &_view, 
+                     vec_t *_out_points, 
+                     size_t _max_count, 
+                     size_t &_out_count);
+    void getAABBLines(OrthtreeBH *_qt, 
+                      const AABB<D> &_view, 
+                      vec_t *_out_lines, 
+                      size_t _max_count, 
+                      size_t &_out_count);
+    void getAABBs(OrthtreeBH *_qt, 
+                  const AABB<D> &_view, 
+                  box_t *_out_aabbs, 
+                  size_t _max_count, 
+                  size_t &_out_count);
 
     // Find the closest vertex to an incoming vector (for interactive debugging)
-    void getClosestVertex(QuadtreeBH *_qt, 
-                          const glm::vec2 &_cmp_vertex, 
-                          glm::vec2 &_out_closest);
+    void getClosestVertex(OrthtreeBH *_qt, 
+                          const vec_t &_cmp_vertex, 
+                          vec_t &_out_closest);
+
+    // Interrogate the tree for incoming vector and return its AABB; the selected leaf is 
+    // always written, NULL over empty quadrants
+    void getSelectedAABB(OrthtreeBH *_qt, const vec_t _v, AABB<D> &_out_aabb);
+    void getSelectedSubtree(OrthtreeBH *_qt, const vec_t &_v, OrthtreeBH **_out_qt);
 
-    // Interrogate the tree for incoming vector and return AABB2
-    void getSelectedAABB(QuadtreeBH *_qt, const glm::vec2 _v, AABB2 &_out_aabb);
-    void getSelectedSubtree(QuadtreeBH *_qt, const glm::vec2 &_v, QuadtreeBH **_out_qt);
+    // Point location through the hashed index: the leaf _v would be inserted into, or
+    // NULL if _v is outside the tree or in an empty quadrant. Must be called on the root.
+    OrthtreeBH *getLeaf(OrthtreeBH *_qt, const vec_t &_v);
 
     // Barnes-Hut approximation ---------------------------------------------------------
     //
 
     // Get vertices (and masses) of the tree based on Barnes-Hut approximation for 
-    // distant vertices. A 3-comp vector is used for this (for shader packing) where
-    // .xy is the position of the mean vertex and .z is the mass
-    void approxBH(QuadtreeBH *_qt, 
-                  const glm::vec2 &_cmp_vertex, 
-                  std::vector<glm::vec3> &_out_v_bh);
+    // distant vertices. A (D + 1)-comp vector is used for this (for shader packing) 
+    // where the first D components are the position of the mean vertex and the last is
+    // the mass (.xy and .z in 2D)
+    void approxBH(OrthtreeBH *_qt, 
+                  const vec_t &_cmp_vertex, 
+                  std::vector<bh_t> &_out_v_bh);
+    // Same, using a selectable opening criterion (scalar traversal)
+    void approxBH(OrthtreeBH *_qt, 
+                  const vec_t &_cmp_vertex, 
+                  const BHOpening &_opening,
+                  std::vector<bh_t> &_out_v_bh);
+
+    // The Barnes-Hut opening criterion: true if this node is too close to _cmp_vertex
+    // to be approximated by its mean, i.e. its children (or vertices) must be visited.
+    bool isCloseBH(const vec_t &_cmp_vertex) { return isCloseBH(_cmp_vertex, s_thetaBH); }
+    bool isCloseBH(const vec_t &_cmp_vertex, float _theta);
+    bool isCloseBH(const vec_t &_cmp_vertex, const BHOpening &_opening);
+
+    // Softened gravitational acceleration (per unit mass and G) at _v from all vertices,
+    // using the Barnes-Hut approximation with opening angle _theta (or the given opening
+    // criterion). Thread-safe, and doesn't allocate.
+    vec_t accelerationBH(OrthtreeBH *_qt, 
+                         const vec_t &_v, 
+                         float _theta, 
+                         float _softening)
+    { return accelerationBH(_qt, _v, BHOpening(_theta), _softening); }
+    vec_t accelerationBH(OrthtreeBH *_qt, 
+                         const vec_t &_v, 
+                         const BHOpening &_opening, 
+                         float _softening);
+
+    // Student-t (t-SNE) repulsion at _v, i.e. with q = 1 / (1 + |_v - w|^2) over all 
+    // vertices w (Barnes-Hut approximated), _out_force = sum q^2 (_v - w) and the 
+    // return value is the contribution sum q to the normalization term Z. The force
+    // isn't normalized; divide by the total Z. If _is_vertex, _v is a vertex of the tree
+    // and its self-interaction is excluded: skipped in its leaf if that is opened, or 
+    // removed from the aggregate of the (farther) node approximated in its place.
+    float repulsionBH(OrthtreeBH *_qt, 
+                      const vec_t &_v, 
+                      float _theta, 
+                      vec_t &_out_force,
+                      bool _is_vertex=false);
 
 
     // Overloads for std::shared_ptr<> --------------------------------------------------
     __attribute__((always_inline))
-    void destroy(std::shared_ptr<QuadtreeBH> _qt) 
+    void destroy(std::shared_ptr<OrthtreeBH> _qt) 
     { destroy(_qt.get()); }
     
     __attribute__((always_inline))
-    void insert(std::shared_ptr<QuadtreeBH> _qt, const glm::vec2 &_v)
+    void insert(std::shared_ptr<OrthtreeBH> _qt, const vec_t &_v)
     { insert(_qt.get(), _v); }
+
+    __attribute__((always_inline))
+    void insert(std::shared_ptr<OrthtreeBH> _qt, const vec_t *_v, size_t _count)
+    { insert(_qt.get(), _v, _count); }
+
+    __attribute__((always_inline))
+    void compact(std::shared_ptr<OrthtreeBH> _qt, QuadtreeLayout _layout=QUADTREE_LAYOUT_DFS)
+    { compact(_qt.get(), _layout); }
+
+    template<typename V>
+    __attribute__((always_inline))
+    void traverse(std::shared_ptr<OrthtreeBH> _qt, V &_visitor)
+    { traverse(_qt.get(), _visitor); }
+
+    __attribute__((always_inline))
+    void insertAggregate(std::shared_ptr<OrthtreeBH> _qt, 
+                         uint32_t _key, 
+                         const vec_t &_total, 
+                         uint32_t _count)
+    { insertAggregate(_qt.get(), _key, _total, _count); }
     
     __attribute__((always_inline))
-    uint32_t depth(std::shared_ptr<QuadtreeBH> _qt) 
+    uint32_t depth(std::shared_ptr<OrthtreeBH> _qt) 
     { return depth(_qt.get());  }
 
     __attribute__((always_inline))
-    void getVertices(std::shared_ptr<QuadtreeBH> _qt, 
-                     std::vector<glm::vec2> &_out_vec_points)
+    size_t nodeCount(std::shared_ptr<OrthtreeBH> _qt) 
+    { return nodeCount(_qt.get());  }
+
+    __attribute__((always_inline))
+    size_t memoryUsage(std::shared_ptr<OrthtreeBH> _qt) 
+    { return memoryUsage(_qt.get());  }
+
+    __attribute__((always_inline))
+    void exportVertices(std::shared_ptr<OrthtreeBH> _qt, vec_t *_out_points)
+    { exportVertices(_qt.get(), _out_points); }
+
+    __attribute__((always_inline))
+    void exportAABBs(std::shared_ptr<OrthtreeBH> _qt, box_t *_out_aabbs)
+    { exportAABBs(_qt.get(), _out_aabbs); }
+
+    __attribute__((always_inline))
+    void exportAABBLines(std::shared_ptr<OrthtreeBH> _qt, vec_t *_out_lines)
+    { exportAABBLines(_qt.get(), _out_lines); }
+
+    __attribute__((always_inline))
+    void getVertices(std::shared_ptr<OrthtreeBH> _qt, 
+                     std::vector<vec_t> &_out_vec_points)
     { getVertices(_qt.get(), _out_vec_points); }
 
     __attribute__((always_inline))
-    void getAABBLines(std::shared_ptr<QuadtreeBH> _qt, 
-                      std::vector<glm::vec2> &_out_vec_lines) 
+    void getAABBLines(std::shared_ptr<OrthtreeBH> _qt, 
+                      std::vector<vec_t> &_out_vec_lines) 
     { getAABBLines(_qt.get(), _out_vec_lines); }
 
     __attribute__((always_inline))
-    void getClosestVertex(std::shared_ptr<QuadtreeBH> _qt, 
-                          const glm::vec2 &_cmp_vertex,
-                          glm::vec2 &_out_closest)
+    void getAABBs(std::shared_ptr<OrthtreeBH> _qt, 
+                  std::vector<box_t> &_out_vec_aabbs) 
+    { getAABBs(_qt.get(), _out_vec_aabbs); }
+
+    __attribute__((always_inline))
+    void getVertices(std::shared_ptr<OrthtreeBH> _qt, 
+                     const AABB<D> &_view, 
+                     vec_t *_out_points, 
+                     size_t _max_count, 
+                     size_t &_out_count)
+    { getVertices(_qt.get(), _view, _out_points, _max_count, _out_count); }
+
+    __attribute__((always_inline))
+    void getAABBLines(std::shared_ptr<OrthtreeBH> _qt, 
+                      const AABB<D> &_view, 
+                      vec_t *_out_lines, 
+                      size_t _max_count, 
+                      size_t &_out_count)
+    { getAABBLines(_qt.get(), _view, _out_lines, _max_count, _out_count); }
+
+    __attribute__((always_inline))
+    void getAABBs(std::shared_ptr<OrthtreeBH> _qt, 
+                  const AABB<D> &_view, 
+                  box_t *_out_aabbs, 
+                  size_t _max_count, 
+                  size_t &_out_count)
+    { getAABBs(_qt.get(), _view, _out_aabbs, _max_count, _out_count); }
+
+    __attribute__((always_inline))
+    void getClosestVertex(std::shared_ptr<OrthtreeBH> _qt, 
+                          const vec_t &_cmp_vertex,
+                          vec_t &_out_closest)
     { getClosestVertex(_qt.get(), _cmp_vertex, _out_closest); }
 
     __attribute__((always_inline))
-    void getSelectedAABB(std::shared_ptr<QuadtreeBH> _qt, 
-                         const glm::vec2 _v, 
-                         AABB2 &_out_aabb) 
+    void getSelectedAABB(std::shared_ptr<OrthtreeBH> _qt, 
+                         const vec_t _v, 
+                         AABB<D> &_out_aabb) 
     { getSelectedAABB(_qt.get(), _v, _out_aabb); }
 
     __attribute__((always_inline))
-    void getSelectedSubtree(std::shared_ptr<QuadtreeBH> _qt, 
-                            const glm::vec2 &_v, 
-                            QuadtreeBH **_out_qt)
+    void getSelectedSubtree(std::shared_ptr<OrthtreeBH> _qt, 
+                            const vec_t &_v, 
+                            OrthtreeBH **_out_qt)
     { getSelectedSubtree(_qt.get(), _v, _out_qt); }
 
     __attribute__((always_inline))
-    void approxBH(std::shared_ptr<QuadtreeBH> _qt, 
-                  const glm::vec2 &_cmp_vertex, 
-                  std::vector<glm::vec3> &_out_v_bh)
+    OrthtreeBH *getLeaf(std::shared_ptr<OrthtreeBH> _qt, const vec_t &_v)
+    { return getLeaf(_qt.get(), _v); }
+
+    __attribute__((always_inline))
+    void approxBH(std::shared_ptr<OrthtreeBH> _qt, 
+                  const vec_t &_cmp_vertex, 
+                  std::vector<bh_t> &_out_v_bh)
     { approxBH(_qt.get(), _cmp_vertex, _out_v_bh); }
 
+    __attribute__((always_inline))
+    void approxBH(std::shared_ptr<OrthtreeBH> _qt, 
+                  const vec_t &_cmp_vertex, 
+                  const BHOpening &_opening,
+                  std::vector<bh_t> &_out_v_bh)
+    { approxBH(_qt.get(), _cmp_vertex, _opening, _out_v_bh); }
 
+    __attribute__((always_inline))
+    float repulsionBH(std::shared_ptr<OrthtreeBH> _qt, 
+                      const vec_t &_v, 
+                      float _theta, 
+                      vec_t &_out_force,
+                      bool _is_vertex=false)
+    { return repulsionBH(_qt.get(), _v, _theta, _out_force, _is_vertex); }
+
+    __attribute__((always_inline))
+    vec_t accelerationBH(std::shared_ptr<OrthtreeBH> _qt, 
+                         const vec_t &_v, 
+                         float _theta, 
+                         float _softening)
+    { return accelerationBH(_qt.get(), _v, _theta, _softening); }
+
+    __attribute__((always_inline))
+    vec_t accelerationBH(std::shared_ptr<OrthtreeBH> _qt, 
+                         const vec_t &_v, 
+                         const BHOpening &_opening, 
+                         float _softening)
+    { return accelerationBH(_qt.get(), _v, _opening, _softening); }
 
-protected:
-    void split(QuadtreeBH *_qt);
-    uint8_t getChildIndex(QuadtreeBH *_qt, const glm::vec2 &_v);
 
 
 protected:
-    QuadtreeBH *m_children[4];
-    AABB2 m_aabb;
-    uint32_t m_level;
-    std::vector<glm::vec2> m_vertices;
-    size_t m_maxVertices;
+    OrthtreeBH(OrthtreeState<D> *_tree, uint32_t _key);
+
+    uint32_t split(OrthtreeBH *_qt, const vec_t &_v);
+    uint32_t insertBelow(OrthtreeBH *_qt, const vec_t &_v);
+    // (_leaves: slab of the calling thread, see insertParallel(), or NULL for the tree's)
+    void pushVertex(OrthtreeBH *_qt, const vec_t &_v, OrthtreeLeafSlab<D> *_leaves=NULL);
+    OrthtreeBH *addChild(OrthtreeBH *_qt, uint8_t _idx);
+    // (_index false: the index and relocations are left to the caller, see insertParallel())
+    void addChildren(OrthtreeBH *_qt, uint8_t _mask, bool _index=true);
+
+    // Parallel batch insert: insertSorted() fills the top levels, deferring subtrees
+    // receiving at most 'grain' vertices as tasks, which insertParallel() then fills 
+    // concurrently (the nodes of the top levels aren't moved once their children exist)
+    struct InsertTask
+    {
+        OrthtreeBH *node;
+        vec_t *v;
+        size_t n;
+        uint32_t newLeaves;
+    };
+    struct InsertSchedule
+    {
+        size_t grain;
+        std::vector<InsertTask> tasks;
+        std::vector<std::vector<vec_t>> buffers;   // merged leaf vertices of tasks
+    };
+    uint32_t insertSorted(OrthtreeBH *_qt, 
+                          vec_t *_v, 
+                          size_t _n, 
+                          OrthtreeLeafSlab<D> *_leaves=NULL, 
+                          InsertSchedule *_schedule=NULL);
+    uint32_t insertParallel(OrthtreeBH *_qt, vec_t *_v, size_t _n);
+    // compressed mode
+    uint32_t descendKey(OrthtreeBH *_qt, const vec_t &_v, uint32_t _level);
+    uint32_t splitEdge(OrthtreeBH *_qt, uint8_t _idx, const vec_t &_v);
+    void rekey(OrthtreeBH *_qt, uint32_t _key);
+    uint8_t getChildIndex(OrthtreeBH *_qt, const vec_t &_v);
+    // child quadrant of _v in the node at _level, cell _cell: float midpoint 
+    // comparisons, or bit extraction from the quantized _q in quantized mode
+    __attribute__((always_inline))
+    static uint8_t childIndex(const OrthtreeState<D> *_tree, 
+                              uint32_t _level, 
+                              const cell_t &_cell, 
+                              const vec_t &_v, 
+                              const cell_t &_q)
+    {
+        if (_tree->quantized)
+            return OrthtreeState<D>::quadrant(_q, _level);
+        // (the midpoint of the node is the lower corner of its last child)
+        return quadrant(_v, _tree->cellMin(_level + 1, childCell(_cell, CHILD_COUNT - 1)));
+    }
+    // child quadrant of _v in the node with midpoint _mid: bit d set if _v[d] > _mid[d]
+    __attribute__((always_inline))
+    static uint8_t quadrant(const vec_t &_v, const vec_t &_mid)
+    {
+        uint8_t idx = 0;
+        for (int d = 0; d < D; d++)
+            idx |= (_v[d] > _mid[d]) << d;
+        return idx;
+    }
+    // cell of child _idx of the node at _cell (one level down)
+    __attribute__((always_inline))
+    static cell_t childCell(const cell_t &_cell, uint8_t _idx)
+    {
+        cell_t c;
+        for (int d = 0; d < D; d++)
+            c[d] = 2 * _cell[d] + ((_idx >> d) & 1);
+        return c;
+    }
+    // (2^D children tested in SIMD groups of 4)
+    void approxBH4(OrthtreeBH *_qt, 
+                   const vec_t &_cmp_vertex, 
+                   std::vector<bh_t> &_out_v_bh);
+
+    // child node in quadrant _idx, or NULL if that quadrant is empty
+    __attribute__((always_inline))
+    OrthtreeBH *getChild(uint8_t _idx)
+    {
+        if (!(m_childMask & (1 << _idx)))
+            return NULL;
+        return &m_children[__builtin_popcount(m_childMask & ((1 << _idx) - 1))];
+    }
+    __attribute__((always_inline))
+    int childCount() { return __builtin_popcount(m_childMask); }
+
+    static void vebOrder(OrthtreeBH *_qt, uint32_t _height, std::vector<OrthtreeBH *> &_out_order);
 
+
+protected:
+    OrthtreeBH *m_children = NULL;      // packed, childCount() nodes
+    OrthtreeState<D> *m_tree = NULL;
+    // leaf storage: a block of tree->leaves, or (maxDepth leaves holding more than 
+    // MAX_VERTICES_PER_NODE vertices only) a heap buffer, see pushVertex()
+    vec_t *m_vertices = NULL;
+    
     // Barnes-Hut variables
-    glm::vec2 m_mean = glm::vec2(0.0f); // mean of all vertices at this node or below
-    glm::vec2 m_total = glm::vec2(0.0f); // adds per incoming point
+    vec_t m_total = vec_t(0.0f); // adds per incoming point
     uint32_t m_vertexCount = 0; // corresponding to the mass
 
+    uint32_t m_localCount = 0;  // number of vertices in m_vertices
+    uint32_t m_key = 1;         // location code (see OrthtreeIndex)
+    // (bit fields, to fit in what would otherwise be padding)
+    uint32_t m_childMask : CHILD_COUNT;         // bit i set if quadrant i has a child node
+    uint32_t m_leafCount : 32 - CHILD_COUNT;    // leaves in the subtree (1 for a leaf), see ORTHTREE_MAX_LEAF_COUNT
+
 };
 
-extern float s_thetaBH;
+typedef OrthtreeBH<2> QuadtreeBH;
+typedef OrthtreeBH<3> OctreeBH;
+
+extern template class OrthtreeBH<2>;
+extern template class OrthtreeBH<3>;
+
+/* Iterative depth-first traversal with an explicit, fixed-size stack, shared by all tree
+ * walks. next() returns the next node in depth-first order (children in index order);
+ * the children of a node are only visited if open() is called for it. Typical use:
+ *
+ *  QuadtreeTraversal t(_qt);
+ *  while (QuadtreeBH *node = t.next())
+ *      if (<interested in subtree>)
+ *          t.open(node);
+ */
+template<int D>
+class OrthtreeTraversal
+{
+public:
+    OrthtreeTraversal(OrthtreeBH<D> *_qt)
+    {
+        m_stack[0] = _qt;
+        m_top = (_qt != NULL);
+    }
+
+    __attribute__((always_inline))
+    OrthtreeBH<D> *next()
+    { return m_top ? m_stack[--m_top] : NULL; }
+
+    // push children in reverse order, so that they are popped in index order
+    __attribute__((always_inline))
+    void open(OrthtreeBH<D> *_qt)
+    {
+        for (int i = _qt->childCount() - 1; i >= 0; i--)
+            m_stack[m_top++] = &_qt->m_children[i];
+    }
+
+private:
+    OrthtreeBH<D> *m_stack[ORTHTREE_STACK_SIZE(D)];
+    int m_top;
+
+};
+
+typedef OrthtreeTraversal<2> QuadtreeTraversal;
+
+
+/* Base of visitors for OrthtreeBH::traverse(). The visitor type is a template argument,
+ * so a visitor only hides the hooks it needs, without virtual calls:
+ *
+ *  openNode(node)  -- descend into node: its children, or for a leaf, its vertices
+ *  visitNode(node) -- called instead for nodes that aren't opened
+ *  visitPoint(v)   -- vertex of an opened leaf
+ *  done()          -- stops the traversal (checked before every node)
+ *
+ * E.g. counting the vertices inside a region, without materializing them:
+ *
+ *  struct Count : QuadtreeVisitor
+ *  {
+ *      AABB2 region; size_t n = 0;
+ *      bool openNode(QuadtreeBH *_qt) { return region.intersects(_qt->getAABB()); }
+ *      void visitPoint(const glm::vec2 &_v) { n += region.contains(_v); }
+ *  };
+ */
+template<int D>
+struct OrthtreeVisitor
+{
+    bool openNode(OrthtreeBH<D> *) { return true; }
+    void visitNode(OrthtreeBH<D> *) {}
+    void visitPoint(const glm::vec<D, float> &) {}
+    bool done() { return false; }
+};
+
+typedef OrthtreeVisitor<2> QuadtreeVisitor;
+typedef OrthtreeVisitor<3> OctreeVisitor;
+
+/* Visitor base for Barnes-Hut walks from query: opens the nodes that are close by the
+ * opening criterion, so that visitNode() gets the nodes approximated by their aggregates
+ * (empty nodes included, which can be skipped) and visitPoint() the vertices of the
+ * close leaves.
+ */
+template<int D>
+struct OrthtreeBHVisitor : OrthtreeVisitor<D>
+{
+    OrthtreeBHVisitor(const glm::vec<D, float> &_query, const BHOpening &_opening) :
+        query(_query), opening(_opening)
+    {}
+
+    __attribute__((always_inline))
+    bool openNode(OrthtreeBH<D> *_qt)
+    { return _qt->getVertexCount() && !_qt->isAggregate() && _qt->isCloseBH(query, opening); }
+
+    glm::vec<D, float> query;
+    BHOpening opening;
+};
+
+typedef OrthtreeBHVisitor<2> BHVisitor;
+
+//
+template<int D>
+template<typename V>
+inline void OrthtreeBH<D>::traverse(OrthtreeBH *_qt, V &_visitor)
+{
+    OrthtreeTraversal<D> t(_qt);
+    while (OrthtreeBH *node = t.next())
+    {
+        if (_visitor.done())
+            return;
+        
+        if (!_visitor.openNode(node))
+            _visitor.visitNode(node);
+        else if (node->m_children != NULL)
+            t.open(node);
+        else
+        {
+            for (auto &v : node->getLocalVertices())
+                _visitor.visitPoint(v);
+        }
+    }
+}
 
 
 
-#endif // __QUADTREE_H
\ No newline at end of file
+#endif // __QUADTREE_H
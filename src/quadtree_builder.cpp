@@ -0,0 +1,204 @@
+
+#include <chrono>
+#include <functional>
+#include <math.h>
+
+#include "quadtree_builder.h"
+#include "parallel.h"
+
+
+//
+static inline double elapsed_ms(const std::chrono::high_resolution_clock::time_point &_t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _t0).count();
+}
+
+//---------------------------------------------------------------------------------------
+QuadtreeAsyncBuild::QuadtreeAsyncBuild(std::vector<glm::vec2> &&_vertices, 
+                                       size_t _max_vertices, 
+                                       const AABB2 &_aabb) :
+    m_vertices(std::move(_vertices)),
+    m_maxVertices(_max_vertices),
+    m_aabb(_aabb)
+{
+    m_future = m_promise.get_future().share();
+    m_worker = std::thread(&QuadtreeAsyncBuild::build, this);
+}
+
+//---------------------------------------------------------------------------------------
+QuadtreeAsyncBuild::~QuadtreeAsyncBuild()
+{
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+//---------------------------------------------------------------------------------------
+void QuadtreeAsyncBuild::build()
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    publish(buildCoarse());
+    m_coarseTime = elapsed_ms(t0);
+
+    // finer aggregates, down to about the size of the leaves of the full tree
+    sortVertices();
+    size_t leaves = m_vertices.size() / MAX_VERTICES_PER_NODE;
+    for (uint32_t level = ASYNC_BUILD_COARSE_LEVEL + ASYNC_BUILD_LEVEL_STEP; 
+         level < MAX_DEPTH && ((size_t)1 << (2 * level)) < leaves; 
+         level += ASYNC_BUILD_LEVEL_STEP)
+        publish(buildLevel(level));
+    m_keys = std::vector<uint32_t>();
+
+    // (already in the order the batch insert sorts into)
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(m_maxVertices, m_aabb);
+    qt->insert(qt, m_vertices.data(), m_vertices.size());
+    publish(qt);
+    m_fullTime = elapsed_ms(t0);
+
+    m_done.store(true);
+    m_promise.set_value(qt);
+}
+
+//---------------------------------------------------------------------------------------
+std::shared_ptr<QuadtreeBH> QuadtreeAsyncBuild::buildCoarse()
+{
+    // count and sum per cell of the coarse grid, per thread, reduced in thread order
+    const uint32_t level = ASYNC_BUILD_COARSE_LEVEL;
+    const uint32_t res = 1u << level;
+    size_t n_threads = parallel_thread_count();
+    std::vector<glm::vec2> totals(n_threads * res * res, glm::vec2(0.0f));
+    std::vector<uint32_t> counts(n_threads * res * res, 0);
+
+    // same cell assignment as the tree (closed at the upper bound, see getLeaf())
+    glm::vec2 scale = (float)res / (m_aabb.v1 - m_aabb.v0);
+    parallel_for(m_vertices.size(), [&](size_t _begin, size_t _end, size_t _thread)
+    {
+        glm::vec2 *total = &totals[_thread * res * res];
+        uint32_t *count = &counts[_thread * res * res];
+        for (size_t i = _begin; i < _end; i++)
+        {
+            glm::vec2 t = (m_vertices[i] - m_aabb.v0) * scale;
+            uint32_t x = (uint32_t)std::min(std::max(ceilf(t.x) - 1.0f, 0.0f), (float)(res - 1));
+            uint32_t y = (uint32_t)std::min(std::max(ceilf(t.y) - 1.0f, 0.0f), (float)(res - 1));
+            total[y * res + x] += m_vertices[i];
+            count[y * res + x]++;
+        }
+    });
+
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(m_maxVertices, m_aabb);
+    uint32_t shift = MAX_DEPTH - level;
+    for (uint32_t y = 0; y < res; y++)
+    {
+        for (uint32_t x = 0; x < res; x++)
+        {
+            glm::vec2 total(0.0f);
+            uint32_t count = 0;
+            for (size_t t = 0; t < n_threads; t++)
+            {
+                total += totals[t * res * res + y * res + x];
+                count += counts[t * res * res + y * res + x];
+            }
+            if (count)
+                qt->insertAggregate(qt, QuadtreeIndex::levelKey(glm::uvec2(x << shift, y << shift), level), total, count);
+        }
+    }
+
+    return qt;
+}
+
+//---------------------------------------------------------------------------------------
+void QuadtreeAsyncBuild::sortVertices()
+{
+    // location codes at MAX_DEPTH, as computed by the batch insert
+    struct KeyedVertex
+    {
+        uint32_t key;
+        glm::vec2 v;
+        bool operator<(const KeyedVertex &_other) const { return key < _other.key; }
+    };
+    size_t n = m_vertices.size();
+    std::vector<KeyedVertex> keyed(n);
+    glm::vec2 scale = (float)(1u << MAX_DEPTH) / (m_aabb.v1 - m_aabb.v0);
+    int max_cell = (1 << MAX_DEPTH) - 1;
+    parallel_for(n, [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+        {
+            glm::vec2 c = (m_vertices[i] - m_aabb.v0) * scale;
+            uint32_t x = (uint32_t)std::min(std::max((int)floorf(c.x), 0), max_cell);
+            uint32_t y = (uint32_t)std::min(std::max((int)floorf(c.y), 0), max_cell);
+            keyed[i] = { QuadtreeIndex::levelKey(glm::uvec2(x, y), MAX_DEPTH), m_vertices[i] };
+        }
+    });
+    parallel_sort(keyed.begin(), keyed.end(), std::less<KeyedVertex>());
+
+    m_keys.resize(n);
+    parallel_for(n, [&](size_t _begin, size_t _end, size_t)
+    {
+        for (size_t i = _begin; i < _end; i++)
+        {
+            m_keys[i] = keyed[i].key;
+            m_vertices[i] = keyed[i].v;
+        }
+    });
+}
+
+//---------------------------------------------------------------------------------------
+std::shared_ptr<QuadtreeBH> QuadtreeAsyncBuild::buildLevel(uint32_t _level)
+{
+    // runs of equal location codes at _level in the sorted vertices, per thread (in 
+    // order), joined at the chunk boundaries
+    struct Run
+    {
+        uint32_t key;
+        glm::vec2 total;
+        uint32_t count;
+    };
+    uint32_t shift = 2 * (MAX_DEPTH - _level);
+    std::vector<std::vector<Run>> runs(parallel_thread_count());
+    parallel_for(m_vertices.size(), [&](size_t _begin, size_t _end, size_t _thread)
+    {
+        std::vector<Run> &out = runs[_thread];
+        for (size_t i = _begin; i < _end; i++)
+        {
+            uint32_t key = m_keys[i] >> shift;
+            if (out.empty() || out.back().key != key)
+                out.push_back({ key, m_vertices[i], 1 });
+            else
+            {
+                out.back().total += m_vertices[i];
+                out.back().count++;
+            }
+        }
+    });
+
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(m_maxVertices, m_aabb);
+    Run cell = { 0, glm::vec2(0.0f), 0 };
+    for (auto &thread_runs : runs)
+    {
+        for (auto &run : thread_runs)
+        {
+            if (run.key == cell.key)
+            {
+                cell.total += run.total;
+                cell.count += run.count;
+                continue;
+            }
+            if (cell.count)
+                qt->insertAggregate(qt, cell.key, cell.total, cell.count);
+            cell = run;
+        }
+    }
+    if (cell.count)
+        qt->insertAggregate(qt, cell.key, cell.total, cell.count);
+
+    return qt;
+}
+
+//---------------------------------------------------------------------------------------
+void QuadtreeAsyncBuild::publish(const std::shared_ptr<QuadtreeBH> &_qt)
+{
+    std::atomic_store(&m_snapshot, _qt);
+    m_generation++;
+}
+
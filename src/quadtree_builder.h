@@ -0,0 +1,87 @@
+#ifndef __QUADTREE_BUILDER_H
+#define __QUADTREE_BUILDER_H
+
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+
+// level of the aggregate grid of the first snapshot (4^level cells)
+#define ASYNC_BUILD_COARSE_LEVEL    6
+// levels between successive aggregate snapshots
+#define ASYNC_BUILD_LEVEL_STEP      2
+
+
+/* Asynchronous build of a QuadtreeBH on a worker thread, publishing progressively more
+ * complete snapshots of the tree:
+ *
+ *  1. a coarse tree, whose leaves at ASYNC_BUILD_COARSE_LEVEL only hold aggregates 
+ *     (count and sum, see QuadtreeBH::insertAggregate()), computed in parallel -- this 
+ *     is available after milliseconds, and Barnes-Hut queries on it are already 
+ *     complete in mass, just coarser,
+ *  2. aggregate trees of successively finer levels, every ASYNC_BUILD_LEVEL_STEP 
+ *     levels while their cells are larger than the leaves of the full tree: the 
+ *     vertices are sorted by location code (in parallel), so that the aggregates of 
+ *     any level are runs of vertices,
+ *  3. the full tree, batch-inserted from the sorted vertices, with the subtrees below
+ *     the top levels filled in parallel (see QuadtreeBH::insert(_qt, _v, _count)).
+ *
+ * Snapshots are immutable once published (don't insert into them), and are exchanged 
+ * with std::atomic_load()/std::atomic_store(), so getSnapshot() can be polled from any
+ * thread. The final tree is also available through getFuture().
+ */
+class QuadtreeAsyncBuild
+{
+public:
+    QuadtreeAsyncBuild(std::vector<glm::vec2> &&_vertices, 
+                       size_t _max_vertices, 
+                       const AABB2 &_aabb=AABB2());
+    ~QuadtreeAsyncBuild();
+
+    // latest published snapshot, or nullptr before the first one
+    std::shared_ptr<QuadtreeBH> getSnapshot() { return std::atomic_load(&m_snapshot); }
+    // number of snapshots published so far
+    uint32_t getGeneration() { return m_generation.load(); }
+    bool isDone() { return m_done.load(); }
+    std::shared_future<std::shared_ptr<QuadtreeBH>> getFuture() { return m_future; }
+
+    // time (ms) from the start of the build until the coarse and the full tree were 
+    // published, respectively
+    double getCoarseTime() { return m_coarseTime; }
+    double getFullTime() { return m_fullTime; }
+
+
+private:
+    void build();
+    std::shared_ptr<QuadtreeBH> buildCoarse();
+    void sortVertices();
+    std::shared_ptr<QuadtreeBH> buildLevel(uint32_t _level);
+    void publish(const std::shared_ptr<QuadtreeBH> &_qt);
+
+
+private:
+    std::vector<glm::vec2> m_vertices;
+    std::vector<uint32_t> m_keys;   // of the sorted vertices, at MAX_DEPTH
+    size_t m_maxVertices;
+    AABB2 m_aabb;
+
+    std::shared_ptr<QuadtreeBH> m_snapshot = nullptr;
+    std::atomic<uint32_t> m_generation = { 0 };
+    std::atomic<bool> m_done = { false };
+    std::promise<std::shared_ptr<QuadtreeBH>> m_promise;
+    std::shared_future<std::shared_ptr<QuadtreeBH>> m_future;
+
+    double m_coarseTime = 0.0;
+    double m_fullTime = 0.0;
+    std::thread m_worker;
+
+};
+
+
+
+#endif // __QUADTREE_BUILDER_H
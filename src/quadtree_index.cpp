@@ -0,0 +1,189 @@
+
+#include "quadtree_index.h"
+#include "quadtree.h"
+
+
+//
+static inline uint32_t part1By1(uint32_t _x)
+{
+    _x &= 0x0000ffff;
+    _x = (_x | (_x << 8)) & 0x00ff00ff;
+    _x = (_x | (_x << 4)) & 0x0f0f0f0f;
+    _x = (_x | (_x << 2)) & 0x33333333;
+    _x = (_x | (_x << 1)) & 0x55555555;
+    return _x;
+}
+
+//
+static inline uint32_t compact1By1(uint32_t _x)
+{
+    _x &= 0x55555555;
+    _x = (_x | (_x >> 1)) & 0x33333333;
+    _x = (_x | (_x >> 2)) & 0x0f0f0f0f;
+    _x = (_x | (_x >> 4)) & 0x00ff00ff;
+    _x = (_x | (_x >> 8)) & 0x0000ffff;
+    return _x;
+}
+
+// (3D: every third bit, 10 bits)
+static inline uint32_t part1By2(uint32_t _x)
+{
+    _x &= 0x000003ff;
+    _x = (_x | (_x << 16)) & 0xff0000ff;
+    _x = (_x | (_x << 8)) & 0x0300f00f;
+    _x = (_x | (_x << 4)) & 0x030c30c3;
+    _x = (_x | (_x << 2)) & 0x09249249;
+    return _x;
+}
+
+//
+static inline uint32_t compact1By2(uint32_t _x)
+{
+    _x &= 0x09249249;
+    _x = (_x | (_x >> 2)) & 0x030c30c3;
+    _x = (_x | (_x >> 4)) & 0x0300f00f;
+    _x = (_x | (_x >> 8)) & 0xff0000ff;
+    _x = (_x | (_x >> 16)) & 0x000003ff;
+    return _x;
+}
+
+//
+template<int D>
+static inline uint32_t partBits(uint32_t _x)
+{
+    if constexpr (D == 2)
+        return part1By1(_x);
+    else
+        return part1By2(_x);
+}
+
+//
+template<int D>
+static inline uint32_t compactBits(uint32_t _x)
+{
+    if constexpr (D == 2)
+        return compact1By1(_x);
+    else
+        return compact1By2(_x);
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+OrthtreeIndex<D>::OrthtreeIndex(size_t _capacity)
+{
+    // power of two
+    size_t n = 16;
+    while (n < _capacity)
+        n <<= 1;
+    m_keys.assign(n, 0);
+    m_nodes.assign(n, NULL);
+    m_mask = n - 1;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeIndex<D>::insert(uint32_t _key, OrthtreeBH<D> *_qt)
+{
+    // keep load factor below 0.5
+    if (2 * (m_count + 1) > m_keys.size())
+        grow();
+
+    size_t i = slot(_key);
+    while (m_keys[i] != 0 && m_keys[i] != _key)
+        i = (i + 1) & m_mask;
+
+    if (m_keys[i] == 0)
+        m_count++;
+    m_keys[i] = _key;
+    m_nodes[i] = _qt;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeIndex<D>::erase(uint32_t _key)
+{
+    size_t i = slot(_key);
+    while (m_keys[i] != _key)
+    {
+        if (m_keys[i] == 0)
+            return;
+        i = (i + 1) & m_mask;
+    }
+
+    // backward-shift deletion: move later entries of the probe sequence into the hole, 
+    // unless their home slot lies (cyclically) after it
+    size_t j = i;
+    while (true)
+    {
+        j = (j + 1) & m_mask;
+        if (m_keys[j] == 0)
+            break;
+        size_t home = slot(m_keys[j]);
+        if (((j - home) & m_mask) >= ((j - i) & m_mask))
+        {
+            m_keys[i] = m_keys[j];
+            m_nodes[i] = m_nodes[j];
+            i = j;
+        }
+    }
+    m_keys[i] = 0;
+    m_nodes[i] = NULL;
+    m_count--;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+OrthtreeBH<D> *OrthtreeIndex<D>::find(uint32_t _key) const
+{
+    size_t i = slot(_key);
+    while (m_keys[i] != 0)
+    {
+        if (m_keys[i] == _key)
+            return m_nodes[i];
+        i = (i + 1) & m_mask;
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+uint32_t OrthtreeIndex<D>::levelKey(const cell_t &_cell, uint32_t _level)
+{
+    uint32_t shift = ORTHTREE_MAX_DEPTH(D) - _level;
+    uint32_t morton = 0;
+    for (int d = 0; d < D; d++)
+        morton |= partBits<D>(_cell[d] >> shift) << d;
+    return (1u << (D * _level)) | morton;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+typename OrthtreeIndex<D>::cell_t OrthtreeIndex<D>::cell(uint32_t _key)
+{
+    uint32_t morton = _key ^ (1u << (D * level(_key)));
+    cell_t c;
+    for (int d = 0; d < D; d++)
+        c[d] = compactBits<D>(morton >> d);
+    return c;
+}
+
+//---------------------------------------------------------------------------------------
+template<int D>
+void OrthtreeIndex<D>::grow()
+{
+    std::vector<uint32_t> keys(2 * m_keys.size(), 0);
+    std::vector<OrthtreeBH<D> *> nodes(2 * m_keys.size(), NULL);
+    keys.swap(m_keys);
+    nodes.swap(m_nodes);
+    m_mask = m_keys.size() - 1;
+    m_count = 0;
+
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] != 0)
+            insert(keys[i], nodes[i]);
+}
+
+//---------------------------------------------------------------------------------------
+template class OrthtreeIndex<2>;
+template class OrthtreeIndex<3>;
+
@@ -0,0 +1,72 @@
+#ifndef __QUADTREE_INDEX_H
+#define __QUADTREE_INDEX_H
+
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+template<int D> class OrthtreeBH;
+
+
+/* Hashed linear quadtree (octree) index: maps the location code of a node to the node,
+ * using an open-addressing (linear probing) hash table. The location code of a node is
+ * its path from the root, D bits per level (the child index), prefixed by a sentinel bit:
+ *
+ *  root = 1, child i of node k = (k << D) | i
+ *
+ * i.e. the Morton prefix of the node at its level. Since the sentinel is the highest
+ * set bit, the code also encodes the level of the node, and 0 is never a valid code.
+ */
+template<int D>
+class OrthtreeIndex
+{
+public:
+    // cell coordinates (at some level)
+    typedef glm::vec<D, uint32_t> cell_t;
+
+public:
+    OrthtreeIndex(size_t _capacity=1024);
+    ~OrthtreeIndex() = default;
+
+    void insert(uint32_t _key, OrthtreeBH<D> *_qt);
+    void erase(uint32_t _key);
+    OrthtreeBH<D> *find(uint32_t _key) const;
+    size_t size() const { return m_count; }
+    size_t memoryUsage() const { return m_keys.capacity() * sizeof(uint32_t) + m_nodes.capacity() * sizeof(OrthtreeBH<D> *); }
+
+    // Location codes -------------------------------------------------------------------
+    static uint32_t childKey(uint32_t _key, uint8_t _idx) { return (_key << D) | _idx; }
+
+    // Location code at _level from cell coordinates at ORTHTREE_MAX_DEPTH(D) resolution
+    // (MAX_DEPTH in 2D).
+    static uint32_t levelKey(const cell_t &_cell, uint32_t _level);
+
+    // Level and cell coordinates (at that level) of a location code
+    static uint32_t level(uint32_t _key) { return (31 - __builtin_clz(_key)) / D; }
+    static cell_t cell(uint32_t _key);
+
+
+private:
+    void grow();
+    __attribute__((always_inline))
+    size_t slot(uint32_t _key) const { return (size_t)((_key * 0x9e3779b9u) >> 7) & m_mask; }
+
+
+private:
+    std::vector<uint32_t> m_keys;   // 0 == empty slot
+    std::vector<OrthtreeBH<D> *> m_nodes;
+    size_t m_count = 0;
+    size_t m_mask = 0;
+
+};
+
+typedef OrthtreeIndex<2> QuadtreeIndex;
+
+extern template class OrthtreeIndex<2>;
+extern template class OrthtreeIndex<3>;
+
+
+
+#endif // __QUADTREE_INDEX_H
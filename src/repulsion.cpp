@@ -0,0 +1,32 @@
+
+#include "repulsion.h"
+#include "parallel.h"
+
+
+//---------------------------------------------------------------------------------------
+float repulsionBH(QuadtreeBH *_qt, 
+                  const glm::vec2 *_points, 
+                  size_t _n, 
+                  float _theta, 
+                  glm::vec2 *_out_forces)
+{
+    // per-thread partial sums of Z, reduced in a fixed order (deterministic for a given
+    // thread count); doubles, since Z sums up to _n^2 terms. One slot per worker: 
+    // parallel_for() hands out distinct thread indices below parallel_thread_count().
+    std::vector<double> z_partial(parallel_thread_count(), 0.0);
+
+    parallel_for(_n, [&](size_t _begin, size_t _end, size_t _thread)
+    {
+        double z = 0.0;
+        for (size_t i = _begin; i < _end; i++)
+            z += _qt->repulsionBH(_qt, _points[i], _theta, _out_forces[i], true);
+        z_partial[_thread] = z;
+    }, 256);
+
+    double z = 0.0;
+    for (double partial : z_partial)
+        z += partial;
+
+    return (float)z;
+}
+
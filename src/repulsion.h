@@ -0,0 +1,37 @@
+#ifndef __REPULSION_H
+#define __REPULSION_H
+
+
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+
+
+/* Repulsive stage of 2D embedding layouts (t-SNE, force-directed graphs): Student-t
+ * repulsion of _n points against all vertices of _qt, in one parallel pass. Writes the 
+ * unnormalized force of each point to _out_forces (caller-provided, _n entries) and 
+ * returns the normalization term Z = sum_{i != j} q_ij. The normalized repulsive 
+ * forces are _out_forces[i] / Z.
+ *
+ * The points are expected to be the vertices of the tree. Their self-interactions are 
+ * excluded during the walk (see QuadtreeBH::repulsionBH()), from both Z and the forces,
+ * also where the node holding a point is approximated by its aggregate. Allocates only
+ * the worker threads and one partial sum of Z per thread.
+ */
+float repulsionBH(QuadtreeBH *_qt, 
+                  const glm::vec2 *_points, 
+                  size_t _n, 
+                  float _theta, 
+                  glm::vec2 *_out_forces);
+
+__attribute__((always_inline))
+inline float repulsionBH(std::shared_ptr<QuadtreeBH> _qt, 
+                         const glm::vec2 *_points, 
+                         size_t _n, 
+                         float _theta, 
+                         glm::vec2 *_out_forces)
+{ return repulsionBH(_qt.get(), _points, _n, _theta, _out_forces); }
+
+
+
+#endif // __REPULSION_H
@@ -0,0 +1,358 @@
+
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <synapse/Debug>
+
+#include "sharded.h"
+
+
+//
+static inline double elapsed_ms(const std::chrono::high_resolution_clock::time_point &_t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _t0).count();
+}
+
+//
+static inline glm::vec2 softenedGravity(const glm::vec2 &_d, float _mass, float _eps2)
+{
+    float r2 = _d.x * _d.x + _d.y * _d.y + _eps2;
+    float inv_r = 1.0f / sqrtf(r2);
+    return _d * (_mass * inv_r * inv_r * inv_r);
+}
+
+//---------------------------------------------------------------------------------------
+QuadtreeShard::QuadtreeShard(Transport *_transport, 
+                             const AABB2 &_aabb, 
+                             const glm::vec2 *_vertices, 
+                             size_t _count) :
+    m_transport(_transport),
+    m_aabb(_aabb),
+    m_bounds(glm::vec2(1e30f), glm::vec2(-1e30f))
+{
+    m_qt = std::make_shared<QuadtreeBH>(std::max(_count, (size_t)1), _aabb);
+    for (size_t i = 0; i < _count; i++)
+    {
+        m_qt->insert(m_qt, _vertices[i]);
+        m_bounds.v0 = glm::min(m_bounds.v0, _vertices[i]);
+        m_bounds.v1 = glm::max(m_bounds.v1, _vertices[i]);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+bool QuadtreeShard::exchangeLET(float _theta)
+{
+    int n = m_transport->size();
+    int r = m_transport->rank();
+
+    // bounds of all shards
+    std::vector<std::vector<uint8_t>> send(n), recv;
+    for (int i = 0; i < n; i++)
+        send[i].assign((uint8_t *)&m_bounds, (uint8_t *)&m_bounds + sizeof(AABB2));
+    if (!m_transport->exchange(send, recv))
+        return false;
+
+    // LET for every other shard
+    for (int i = 0; i < n; i++)
+    {
+        if (i == r)
+            continue;
+        if (recv[i].size() != sizeof(AABB2))
+            return false;
+        AABB2 target;
+        memcpy(&target, recv[i].data(), sizeof(AABB2));
+        exportLET(m_qt.get(), target, _theta, send[i]);
+    }
+    if (!m_transport->exchange(send, recv))
+        return false;
+
+    m_letNodes.assign(n, {});
+    m_letVertices.assign(n, {});
+    for (int i = 0; i < n; i++)
+    {
+        if (i == r)
+            continue;
+        
+        uint32_t header[2] = { 0, 0 };
+        if (recv[i].size() < sizeof(header))
+            return false;
+        memcpy(header, recv[i].data(), sizeof(header));
+        size_t nodes_size = header[0] * sizeof(LETNode);
+        size_t vertices_size = header[1] * sizeof(glm::vec2);
+        if (recv[i].size() != sizeof(header) + nodes_size + vertices_size)
+            return false;
+        
+        // empty vectors may have NULL storage, which memcpy() mustn't be given
+        m_letNodes[i].resize(header[0]);
+        m_letVertices[i].resize(header[1]);
+        if (nodes_size)
+            memcpy(m_letNodes[i].data(), recv[i].data() + sizeof(header), nodes_size);
+        if (vertices_size)
+            memcpy(m_letVertices[i].data(), recv[i].data() + sizeof(header) + nodes_size, vertices_size);
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void QuadtreeShard::exportLET(QuadtreeBH *_qt, 
+                              const AABB2 &_target, 
+                              float _theta, 
+                              std::vector<uint8_t> &_out_data)
+{
+    std::vector<LETNode> nodes;
+    std::vector<glm::vec2> vertices;
+
+    // empty target (no vertices) or empty tree: nothing is needed
+    if (_qt->m_vertexCount && _target.v0.x <= _target.v1.x)
+    {
+        // children of an opened node are reserved contiguously, and filled in when 
+        // popped; the stack holds (node, LET index) pairs
+        std::vector<std::pair<QuadtreeBH *, uint32_t>> stack;
+        nodes.push_back(LETNode());
+        stack.push_back({ _qt, 0 });
+
+        while (!stack.empty())
+        {
+            QuadtreeBH *node = stack.back().first;
+            uint32_t idx = stack.back().second;
+            stack.pop_back();
+
+            LETNode &let = nodes[idx];
+            let.total = node->m_total;
+            let.count = node->m_vertexCount;
+            let.key = node->m_key;
+            let.first = 0;
+            let.childCount = 0;
+            let.vertexCount = 0;
+
+            // close to some point of the target: s >= theta * d_min, with d_min the 
+            // distance from the mean to the target bounds
+            float s = node->m_tree->cellSize(node->getLevel());
+            glm::vec2 mean = node->getMean();
+            glm::vec2 d = glm::max(glm::max(_target.v0 - mean, mean - _target.v1), glm::vec2(0.0f));
+            if (s * s < _theta * _theta * (d.x * d.x + d.y * d.y))
+                continue;
+
+            if (node->m_children != NULL)
+            {
+                uint32_t first = (uint32_t)nodes.size();
+                uint8_t n = node->childCount();
+                let.first = first;
+                let.childCount = n;
+                // (let is invalidated by the resize)
+                nodes.resize(nodes.size() + n);
+                for (uint8_t i = 0; i < n; i++)
+                    stack.push_back({ &node->m_children[i], first + i });
+            }
+            else
+            {
+                let.first = (uint32_t)vertices.size();
+                let.vertexCount = node->m_localCount;
+                for (auto &v : node->getLocalVertices())
+                    vertices.push_back(v);
+            }
+        }
+    }
+
+    uint32_t header[2] = { (uint32_t)nodes.size(), (uint32_t)vertices.size() };
+    _out_data.resize(sizeof(header) + nodes.size() * sizeof(LETNode) + vertices.size() * sizeof(glm::vec2));
+    uint8_t *p = _out_data.data();
+    memcpy(p, header, sizeof(header));
+    if (!nodes.empty())
+        memcpy(p + sizeof(header), nodes.data(), nodes.size() * sizeof(LETNode));
+    if (!vertices.empty())
+        memcpy(p + sizeof(header) + nodes.size() * sizeof(LETNode), vertices.data(), vertices.size() * sizeof(glm::vec2));
+}
+
+//---------------------------------------------------------------------------------------
+glm::vec2 QuadtreeShard::accelerationBH(const glm::vec2 &_v, float _theta, float _softening)
+{
+    glm::vec2 a = m_qt->accelerationBH(m_qt, _v, _theta, _softening);
+    for (size_t i = 0; i < m_letNodes.size(); i++)
+        a += accelerationLET(i, _v, _theta, _softening * _softening);
+    return a;
+}
+
+//---------------------------------------------------------------------------------------
+glm::vec2 QuadtreeShard::accelerationLET(size_t _rank, const glm::vec2 &_v, float _theta, float _eps2)
+{
+    const std::vector<LETNode> &nodes = m_letNodes[_rank];
+    const std::vector<glm::vec2> &vertices = m_letVertices[_rank];
+    glm::vec2 a(0.0f);
+    if (nodes.empty())
+        return a;
+
+    float root_size = m_aabb.v1.x - m_aabb.v0.x;
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    size_t top = 0;
+    stack[top++] = 0;
+    while (top)
+    {
+        const LETNode &node = nodes[stack[--top]];
+        if (!node.count)
+            continue;
+
+        // same criterion as QuadtreeBH::isCloseBH()
+        float s = ldexpf(root_size, -(int)QuadtreeIndex::level(node.key));
+        float c = (float)node.count;
+        float dx = node.total.x - c * _v.x;
+        float dy = node.total.y - c * _v.y;
+        bool is_close = s * s * c * c >= _theta * _theta * (dx * dx + dy * dy);
+
+        if (is_close && node.childCount)
+        {
+            for (uint32_t i = node.childCount; i > 0; i--)
+                stack[top++] = node.first + i - 1;
+        }
+        else if (is_close && node.vertexCount)
+        {
+            for (uint32_t i = 0; i < node.vertexCount; i++)
+                a += softenedGravity(vertices[node.first + i] - _v, 1.0f, _eps2);
+        }
+        // far (or, within rounding, an unopened node of the LET)
+        else
+            a += softenedGravity(node.total / c - _v, c, _eps2);
+    }
+
+    return a;
+}
+
+//---------------------------------------------------------------------------------------
+size_t QuadtreeShard::getLETNodeCount()
+{
+    size_t n = 0;
+    for (auto &nodes : m_letNodes)
+        n += nodes.size();
+    return n;
+}
+
+//---------------------------------------------------------------------------------------
+size_t QuadtreeShard::getLETVertexCount()
+{
+    size_t n = 0;
+    for (auto &vertices : m_letVertices)
+        n += vertices.size();
+    return n;
+}
+
+//---------------------------------------------------------------------------------------
+bool shardedAccelerationBH(const std::vector<glm::vec2> &_vertices, 
+                           const AABB2 &_aabb, 
+                           const ShardedParams &_params, 
+                           std::vector<glm::vec2> &_out_accelerations,
+                           ShardedTimings *_out_timings)
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+    ShardedTimings timings;
+    int n_shards = (int)std::max(_params.shards, (size_t)1);
+    size_t n = _vertices.size();
+
+    // partition: sort by location code at MAX_DEPTH (i.e. Morton order), and split into
+    // equal contiguous ranges
+    auto t = std::chrono::high_resolution_clock::now();
+    std::vector<std::pair<uint32_t, uint32_t>> order(n);
+    glm::vec2 scale = (float)(1u << MAX_DEPTH) / (_aabb.v1 - _aabb.v0);
+    uint32_t max_cell = (1u << MAX_DEPTH) - 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        glm::vec2 c = (_vertices[i] - _aabb.v0) * scale;
+        uint32_t x = (uint32_t)std::min(std::max(c.x, 0.0f), (float)max_cell);
+        uint32_t y = (uint32_t)std::min(std::max(c.y, 0.0f), (float)max_cell);
+        order[i] = { QuadtreeIndex::levelKey(glm::uvec2(x, y), MAX_DEPTH), (uint32_t)i };
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<glm::vec2> sorted(n);
+    for (size_t i = 0; i < n; i++)
+        sorted[i] = _vertices[order[i].second];
+    auto shard_begin = [&](int _rank) { return n * _rank / n_shards; };
+    timings.partition = elapsed_ms(t);
+
+    // one process per shard
+    SocketTransport transport(n_shards);
+    std::vector<pid_t> children;
+    int rank = 0;
+    for (int i = 1; i < n_shards; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            rank = i;
+            break;
+        }
+        if (pid < 0)
+        {
+            SYN_WARNING("fork() failed; aborting sharded evaluation.");
+            // the ranks already started fail their exchange once the parent's ends 
+            // (including those of the missing ranks) are closed, and exit
+            transport.closeAll();
+            for (pid_t child : children)
+                waitpid(child, NULL, 0);
+            return false;
+        }
+        children.push_back(pid);
+    }
+    transport.setRank(rank);
+
+    size_t begin = shard_begin(rank);
+    size_t count = shard_begin(rank + 1) - begin;
+
+    t = std::chrono::high_resolution_clock::now();
+    QuadtreeShard shard(&transport, _aabb, sorted.data() + begin, count);
+    timings.build = elapsed_ms(t);
+
+    t = std::chrono::high_resolution_clock::now();
+    bool ok = shard.exchangeLET(_params.theta);
+    timings.let = elapsed_ms(t);
+    timings.letNodes = shard.getLETNodeCount();
+    timings.letVertices = shard.getLETVertexCount();
+
+    t = std::chrono::high_resolution_clock::now();
+    std::vector<glm::vec2> accelerations(count);
+    for (size_t i = 0; ok && i < count; i++)
+        accelerations[i] = shard.accelerationBH(sorted[begin + i], _params.theta, _params.softening);
+    timings.force = elapsed_ms(t);
+
+    // gather on rank 0
+    if (rank != 0)
+    {
+        transport.send(0, accelerations.data(), ok ? count * sizeof(glm::vec2) : 0);
+        _exit(ok ? 0 : 1);
+    }
+
+    _out_accelerations.resize(n);
+    for (size_t i = 0; i < count; i++)
+        _out_accelerations[order[i].second] = accelerations[i];
+    
+    std::vector<uint8_t> data;
+    for (int i = 1; i < n_shards; i++)
+    {
+        size_t b = shard_begin(i);
+        size_t c = shard_begin(i + 1) - b;
+        if (!transport.recv(i, data) || data.size() != c * sizeof(glm::vec2))
+        {
+            ok = false;
+            continue;
+        }
+        const glm::vec2 *a = (const glm::vec2 *)data.data();
+        for (size_t j = 0; j < c; j++)
+            _out_accelerations[order[b + j].second] = a[j];
+    }
+
+    for (pid_t child : children)
+    {
+        int status = 0;
+        waitpid(child, &status, 0);
+        ok &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    timings.total = elapsed_ms(t0);
+    if (_out_timings != NULL)
+        *_out_timings = timings;
+
+    return ok;
+}
+
@@ -0,0 +1,117 @@
+#ifndef __SHARDED_H
+#define __SHARDED_H
+
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+#include "transport.h"
+
+
+// Node of a locally essential tree (LET): the part of a remote shard's tree needed for
+// all Barnes-Hut walks from within the bounds of the receiving shard.
+struct LETNode
+{
+    glm::vec2 total;        // sum of the vertices (see QuadtreeBH::getMean())
+    uint32_t count;
+    uint32_t key;           // location code, in the root shared by all shards
+    uint32_t first;         // index of the first child, or the first vertex
+    uint32_t childCount;    // opened internal node: number of (contiguous) children
+    uint32_t vertexCount;   // opened leaf: number of (contiguous) vertices
+};
+
+//
+struct ShardedParams
+{
+    size_t shards = 4;
+    float theta = 0.5f;
+    float softening = 1e-3f;
+};
+
+// Wall-clock time (ms) of the phases on rank 0, and the LET sizes received by rank 0
+struct ShardedTimings
+{
+    double partition = 0.0;
+    double build = 0.0;
+    double let = 0.0;
+    double force = 0.0;
+    double total = 0.0;
+    size_t letNodes = 0;
+    size_t letVertices = 0;
+};
+
+
+/* One shard of a domain-decomposed tree: a QuadtreeBH over the vertices of this rank 
+ * (with the root shared by all shards, so that location codes and node sizes agree), 
+ * plus the LETs received from all other ranks. 
+ *
+ * A node is put in the LET for a remote shard unopened if it is far (see 
+ * QuadtreeBH::isCloseBH()) from every point of the remote shard's bounding box, so the
+ * walk over a LET never needs anything that wasn't sent.
+ */
+class QuadtreeShard
+{
+public:
+    QuadtreeShard(Transport *_transport, 
+                  const AABB2 &_aabb, 
+                  const glm::vec2 *_vertices, 
+                  size_t _count);
+    ~QuadtreeShard() = default;
+
+    // Exchanges the shard bounds and the LETs with all other ranks (collective)
+    bool exchangeLET(float _theta);
+
+    // Softened acceleration (per unit mass and G) at _v from all shards
+    glm::vec2 accelerationBH(const glm::vec2 &_v, float _theta, float _softening);
+
+    // LET of _qt for a shard with bounds _target, serialized as
+    // [uint32 node count][uint32 vertex count][LETNode * nodes][glm::vec2 * vertices]
+    static void exportLET(QuadtreeBH *_qt, 
+                          const AABB2 &_target, 
+                          float _theta, 
+                          std::vector<uint8_t> &_out_data);
+
+    // Accessors ------------------------------------------------------------------------
+    std::shared_ptr<QuadtreeBH> &getTree() { return m_qt; }
+    const AABB2 &getBounds() { return m_bounds; }
+    size_t getLETNodeCount();
+    size_t getLETVertexCount();
+
+
+private:
+    glm::vec2 accelerationLET(size_t _rank, const glm::vec2 &_v, float _theta, float _eps2);
+
+
+private:
+    Transport *m_transport = nullptr;
+    AABB2 m_aabb;           // root, shared by all shards
+    AABB2 m_bounds;         // bounding box of the vertices of this shard
+    std::shared_ptr<QuadtreeBH> m_qt = nullptr;
+
+    // per rank
+    std::vector<std::vector<LETNode>> m_letNodes;
+    std::vector<std::vector<glm::vec2>> m_letVertices;
+
+};
+
+
+/* Sharded Barnes-Hut accelerations: partitions _vertices into _params.shards 
+ * contiguous Morton-key ranges, and fork()s one process per shard (the calling process
+ * being rank 0), connected by a SocketTransport. Each process builds the tree of its 
+ * shard, exchanges LETs and computes the accelerations of its vertices on one thread; 
+ * the results are gathered into _out_accelerations (in the order of _vertices).
+ *
+ * As with any fork() of a multi-threaded process, call this from a headless process or
+ * before starting other threads.
+ */
+bool shardedAccelerationBH(const std::vector<glm::vec2> &_vertices, 
+                           const AABB2 &_aabb, 
+                           const ShardedParams &_params, 
+                           std::vector<glm::vec2> &_out_accelerations,
+                           ShardedTimings *_out_timings=NULL);
+
+
+
+#endif // __SHARDED_H
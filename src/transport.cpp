@@ -0,0 +1,161 @@
+
+#include <thread>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <synapse/Debug>
+
+#include "transport.h"
+
+
+//---------------------------------------------------------------------------------------
+bool Transport::exchange(const std::vector<std::vector<uint8_t>> &_send, 
+                         std::vector<std::vector<uint8_t>> &_out_recv)
+{
+    int n = size();
+    int r = rank();
+    _out_recv.resize(n);
+
+    // step k: send to r + k, receive from r - k
+    bool send_ok = true;
+    std::thread sender([&]()
+    {
+        for (int k = 1; k < n; k++)
+        {
+            int dst = (r + k) % n;
+            send_ok &= send(dst, _send[dst].data(), _send[dst].size());
+        }
+    });
+
+    bool recv_ok = true;
+    for (int k = 1; k < n; k++)
+        recv_ok &= recv((r - k + n) % n, _out_recv[(r - k + n) % n]);
+
+    sender.join();
+    return send_ok && recv_ok;
+}
+
+//---------------------------------------------------------------------------------------
+static bool write_all(int _fd, const void *_data, size_t _size)
+{
+    const uint8_t *p = (const uint8_t *)_data;
+    while (_size)
+    {
+        // no SIGPIPE if the peer process died
+        ssize_t n = ::send(_fd, p, _size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        _size -= n;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+static bool read_all(int _fd, void *_data, size_t _size)
+{
+    uint8_t *p = (uint8_t *)_data;
+    while (_size)
+    {
+        ssize_t n = ::read(_fd, p, _size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        _size -= n;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+SocketTransport::SocketTransport(int _size) :
+    m_size(_size)
+{
+    m_fds.resize(_size * _size, -1);
+    for (int a = 0; a < _size; a++)
+    {
+        for (int b = a + 1; b < _size; b++)
+        {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+            {
+                SYN_WARNING("socketpair() failed (errno ", errno, ").");
+                continue;
+            }
+            fd(a, b) = sv[0];
+            fd(b, a) = sv[1];
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+SocketTransport::~SocketTransport()
+{
+    closeAll();
+}
+
+//---------------------------------------------------------------------------------------
+void SocketTransport::closeAll()
+{
+    for (int &f : m_fds)
+    {
+        if (f >= 0)
+            ::close(f);
+        f = -1;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void SocketTransport::setRank(int _rank)
+{
+    m_rank = _rank;
+    
+    // close the ends belonging to other ranks
+    for (int a = 0; a < m_size; a++)
+    {
+        if (a == _rank)
+            continue;
+        for (int b = 0; b < m_size; b++)
+        {
+            if (fd(a, b) >= 0)
+                ::close(fd(a, b));
+            fd(a, b) = -1;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+bool SocketTransport::send(int _dst, const void *_data, size_t _size)
+{
+    int f = fd(m_rank, _dst);
+    uint64_t size = _size;
+    if (f < 0 || !write_all(f, &size, sizeof(size)) || !write_all(f, _data, _size))
+    {
+        SYN_WARNING("rank ", m_rank, ": send to rank ", _dst, " failed.");
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool SocketTransport::recv(int _src, std::vector<uint8_t> &_out_data)
+{
+    int f = fd(m_rank, _src);
+    uint64_t size = 0;
+    if (f < 0 || !read_all(f, &size, sizeof(size)))
+    {
+        SYN_WARNING("rank ", m_rank, ": receive from rank ", _src, " failed.");
+        return false;
+    }
+    _out_data.resize(size);
+    if (!read_all(f, _out_data.data(), size))
+    {
+        SYN_WARNING("rank ", m_rank, ": receive from rank ", _src, " failed.");
+        return false;
+    }
+    return true;
+}
+
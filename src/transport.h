@@ -0,0 +1,67 @@
+#ifndef __TRANSPORT_H
+#define __TRANSPORT_H
+
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* Message passing between the ranks (processes) of a sharded computation. Messages are
+ * point-to-point and delivered in order per (source, destination) pair; send() and 
+ * recv() block.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    virtual int rank() = 0;
+    virtual int size() = 0;
+    virtual bool send(int _dst, const void *_data, size_t _size) = 0;
+    virtual bool recv(int _src, std::vector<uint8_t> &_out_data) = 0;
+
+    // All-to-all exchange: _send[j] is sent to rank j, _out_recv[j] is received from 
+    // rank j (own entries are ignored). Uses a ring schedule, with sends on a separate 
+    // thread, so that large messages can't deadlock.
+    bool exchange(const std::vector<std::vector<uint8_t>> &_send, 
+                  std::vector<std::vector<uint8_t>> &_out_recv);
+
+};
+
+/* Local transport for ranks on the same machine: a full mesh of Unix stream socket 
+ * pairs. Construct in the parent process for all ranks, fork(), and call setRank() in 
+ * every process (including the parent) to keep only its own end of each pair.
+ */
+class SocketTransport : public Transport
+{
+public:
+    SocketTransport(int _size);
+    ~SocketTransport();
+
+    void setRank(int _rank);
+    // close all ends held by this process, so that blocked peers see end-of-stream 
+    // (e.g. when not all ranks could be started)
+    void closeAll();
+
+    virtual int rank() override { return m_rank; }
+    virtual int size() override { return m_size; }
+    virtual bool send(int _dst, const void *_data, size_t _size) override;
+    virtual bool recv(int _src, std::vector<uint8_t> &_out_data) override;
+
+
+private:
+    int &fd(int _a, int _b) { return m_fds[_a * m_size + _b]; }
+
+
+private:
+    int m_rank = -1;
+    int m_size = 0;
+    // m_fds[a * size + b]: rank a's end of the socket pair connecting ranks a and b
+    std::vector<int> m_fds;
+
+};
+
+
+
+#endif // __TRANSPORT_H
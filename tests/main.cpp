@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+
+static size_t s_failures = 0;
+
+//---------------------------------------------------------------------------------------
+std::vector<TestCase> &testCases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+//---------------------------------------------------------------------------------------
+void testFailed(const char *_file, int _line, const char *_condition)
+{
+    printf("    %s:%d: CHECK(%s) failed\n", _file, _line, _condition);
+    s_failures++;
+}
+
+//---------------------------------------------------------------------------------------
+// Runs all tests (or those whose name contains argv[1]); the exit code is non-zero if
+// any of them failed.
+int main(int _argc, char **_argv)
+{
+    size_t run = 0;
+    size_t failed = 0;
+    for (auto &test : testCases())
+    {
+        if (_argc > 1 && strstr(test.name, _argv[1]) == NULL)
+            continue;
+
+        printf("%s\n", test.name);
+        s_failures = 0;
+        test.fnc();
+        run++;
+        failed += (s_failures != 0);
+    }
+
+    printf("%zu of %zu tests passed.\n", run - failed, run);
+    return (failed ? 1 : 0);
+}
@@ -0,0 +1,104 @@
+#ifndef __TEST_H
+#define __TEST_H
+
+
+#include <vector>
+#include <stdint.h>
+#include <random>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "src/quadtree.h"
+
+
+// Minimal test cases for the headless test runner (tests/main.cpp). TEST() defines a
+// test function and registers it before main(); CHECK() reports a failed condition and
+// marks the running test as failed, without aborting it.
+typedef void (*TestFnc)();
+
+struct TestCase
+{
+    const char *name;
+    TestFnc fnc;
+};
+
+std::vector<TestCase> &testCases();
+void testFailed(const char *_file, int _line, const char *_condition);
+
+struct TestRegistrar
+{
+    TestRegistrar(const char *_name, TestFnc _fnc) { testCases().push_back({ _name, _fnc }); }
+};
+
+#define TEST(_name) \
+    static void _name(); \
+    static TestRegistrar _name##_registrar(#_name, _name); \
+    static void _name()
+
+#define CHECK(_condition) \
+    do { if (!(_condition)) testFailed(__FILE__, __LINE__, #_condition); } while (0)
+
+// Clustered vertices in [-1, 1]^2, as in layer::__debug_setup_BH_test(), but seeded so
+// that failures are reproducible. Every _duplicates:th vertex (if non-zero) is placed
+// exactly on its cluster center.
+inline std::vector<glm::vec2> clusteredVertices(size_t _clusters,
+                                                size_t _per_cluster,
+                                                float _sigma=0.05f,
+                                                size_t _duplicates=0,
+                                                uint32_t _seed=1)
+{
+    std::mt19937 gen{ _seed };
+    std::normal_distribution<float> norm{ 0.0f, _sigma };
+    std::uniform_real_distribution<float> uniform{ -0.9f, 0.9f };
+    std::vector<glm::vec2> vertices;
+    vertices.reserve(_clusters * _per_cluster);
+    for (size_t i = 0; i < _clusters; i++)
+    {
+        glm::vec2 mpos = glm::vec2(uniform(gen), uniform(gen));
+        for (size_t j = 0; j < _per_cluster; j++)
+        {
+            if (_duplicates && j % _duplicates == 0)
+                vertices.push_back(mpos);
+            else
+                vertices.push_back(glm::clamp(glm::vec2(norm(gen), norm(gen)) + mpos, -1.0f, 1.0f));
+        }
+    }
+    return vertices;
+}
+
+// Lexicographic order, for comparing vertex sets regardless of traversal order
+struct Vec2Less
+{
+    bool operator()(const glm::vec2 &_a, const glm::vec2 &_b) const
+    {
+        return (_a.x < _b.x || (_a.x == _b.x && _a.y < _b.y));
+    }
+};
+
+inline void sortVertices(std::vector<glm::vec2> &_v)
+{
+    std::sort(_v.begin(), _v.end(), Vec2Less());
+}
+
+// True if two trees have the same nodes (bounds, level, vertex count), in depth-first
+// order
+inline bool sameNodes(QuadtreeBH *_a, QuadtreeBH *_b)
+{
+    QuadtreeTraversal a(_a);
+    QuadtreeTraversal b(_b);
+    while (true)
+    {
+        QuadtreeBH *n0 = a.next();
+        QuadtreeBH *n1 = b.next();
+        if (n0 == NULL || n1 == NULL)
+            return (n0 == n1);
+        if (n0->getLevel() != n1->getLevel() || n0->getAABB() != n1->getAABB() ||
+            n0->getVertexCount() != n1->getVertexCount() || n0->isLeaf() != n1->isLeaf())
+            return false;
+        a.open(n0);
+        b.open(n1);
+    }
+}
+
+
+#endif // __TEST_H
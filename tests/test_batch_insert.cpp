@@ -0,0 +1,55 @@
+#include "test.h"
+#include "src/quadtree.h"
+
+
+//---------------------------------------------------------------------------------------
+// Batch inserts (sorted by location code, and filling subtrees concurrently for batches
+// of at least INSERT_PARALLEL_MIN vertices) give the same tree as inserting one by one,
+// into empty and non-empty trees, in every mode
+TEST(batch_insert_matches_single_inserts)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(100, 1000, 0.025f, 10);
+
+    for (QuadtreeFlags flags : { QUADTREE_DEFAULT, QUADTREE_COMPRESSED, QUADTREE_QUANTIZED,
+                                 QUADTREE_COMPRESSED | QUADTREE_QUANTIZED })
+    {
+        std::shared_ptr<QuadtreeBH> ref = std::make_shared<QuadtreeBH>(vertices.size(), AABB2(), flags);
+        for (auto &v : vertices)
+            ref->insert(ref, v);
+        std::vector<glm::vec2> v_ref;
+        ref->getVertices(ref, v_ref);
+        sortVertices(v_ref);
+
+        for (size_t batch : { (size_t)10, (size_t)1000, (size_t)INSERT_PARALLEL_MIN, vertices.size() })
+        {
+            std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size(), AABB2(), flags);
+            for (size_t i = 0; i < vertices.size(); i += batch)
+                qt->insert(qt, vertices.data() + i, std::min(batch, vertices.size() - i));
+
+            CHECK(sameNodes(qt.get(), ref.get()));
+            CHECK(qt->getLeafCount() == ref->getLeafCount());
+            std::vector<glm::vec2> v_qt;
+            qt->getVertices(qt, v_qt);
+            sortVertices(v_qt);
+            CHECK(v_qt == v_ref);
+
+            bool found = true;
+            for (size_t i = 0; i < vertices.size(); i += 101)
+                found &= (qt->getLeaf(qt, vertices[i]) != NULL);
+            CHECK(found);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Batches are capped at the vertex capacity of the tree, as single inserts
+TEST(batch_insert_capacity)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(10, 51);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(500);
+    std::shared_ptr<QuadtreeBH> ref = std::make_shared<QuadtreeBH>(500);
+    qt->insert(qt, vertices.data(), vertices.size());
+    for (auto &v : vertices)
+        ref->insert(ref, v);
+    CHECK(qt->getVertexCount() == ref->getVertexCount());
+}
@@ -0,0 +1,156 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/quadtree.h"
+#include "src/bh_cache.h"
+
+
+// Lexicographic order of interaction list entries
+static void sortInteractions(std::vector<glm::vec3> &_v)
+{
+    std::sort(_v.begin(), _v.end(), [](const glm::vec3 &_a, const glm::vec3 &_b)
+    {
+        return (_a.x < _b.x || (_a.x == _b.x && (_a.y < _b.y || (_a.y == _b.y && _a.z < _b.z))));
+    });
+}
+
+// Softened acceleration at _v from an interaction list (as QuadtreeBH::accelerationBH())
+static glm::vec2 accelerationFromList(const std::vector<glm::vec3> &_list, const glm::vec2 &_v, float _softening)
+{
+    glm::vec2 a = glm::vec2(0.0f);
+    for (auto &w : _list)
+    {
+        glm::vec2 d = glm::vec2(w.x, w.y) - _v;
+        float r2 = glm::dot(d, d) + _softening * _softening;
+        a += d * (w.z / (r2 * sqrtf(r2)));
+    }
+    return a;
+}
+
+// Random vertices inside the leaf holding _v (splitting it, if more than fit)
+static void insertIntoLeaf(std::shared_ptr<QuadtreeBH> &_qt, const glm::vec2 &_v, size_t _n, std::mt19937 &_gen)
+{
+    AABB2 aabb = _qt->getLeaf(_qt, _v)->getAABB();
+    std::uniform_real_distribution<float> u{ 0.01f, 0.99f };
+    for (size_t i = 0; i < _n; i++)
+        _qt->insert(_qt, aabb.v0 + glm::vec2(u(_gen), u(_gen)) * (aabb.v1 - aabb.v0));
+}
+
+//---------------------------------------------------------------------------------------
+// The interaction lists of approxBH() (opening test for four children at once) against
+// a scalar walk with BHVisitor, i.e. QuadtreeBH::isCloseBH() for every node
+TEST(bh_simd_opening_matches_scalar)
+{
+    struct BHListVisitor : BHVisitor
+    {
+        BHListVisitor(const glm::vec2 &_v, float _theta) : BHVisitor(_v, BHOpening(_theta)) {}
+        void visitNode(QuadtreeBH *_qt)
+        {
+            if (_qt->getVertexCount())
+                list.push_back(glm::vec3(_qt->getMean(), (float)_qt->getVertexCount()));
+        }
+        void visitPoint(const glm::vec2 &_v) { list.push_back(glm::vec3(_v, 1.0f)); }
+        std::vector<glm::vec3> list;
+    };
+
+    std::vector<glm::vec2> vertices = clusteredVertices(50, 200, 0.05f, 10);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    float theta = s_thetaBH;
+    std::vector<glm::vec3> v_BH;
+    for (float t : { 0.0f, 0.3f, 0.5f, 1.0f })
+    {
+        s_thetaBH = t;
+        for (size_t i = 0; i < vertices.size(); i += 97)
+        {
+            v_BH.clear();
+            qt->approxBH(qt, vertices[i], v_BH);
+            BHListVisitor visitor(vertices[i], t);
+            qt->traverse(qt, visitor);
+
+            float mass = 0.0f;
+            for (auto &v : v_BH)
+                mass += v.z;
+            CHECK(mass == (float)vertices.size());
+            sortInteractions(v_BH);
+            sortInteractions(visitor.list);
+            CHECK(v_BH == visitor.list);
+        }
+    }
+    s_thetaBH = theta;
+}
+
+//---------------------------------------------------------------------------------------
+// BHInteractionCache: after a few inserts, into leaves near the query (opened, and split
+// by the inserts) and far from it (approximated), the list repaired from the insert log
+// matches a fresh approxBH() and gives the same acceleration; a change of theta or of the
+// query, or more inserts than the repair limit, rebuild the list
+TEST(bh_cache_repair_matches_fresh_list)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(50, 200, 0.05f);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(2 * vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    const float softening = 1e-3f;
+    glm::vec2 q = vertices[0];
+    BHInteractionCache cache;
+    std::vector<glm::vec3> list = cache.approxBH(qt, q);
+    CHECK(cache.getRebuildCount() == 1 && cache.changed());
+    cache.approxBH(qt, q);
+    CHECK(cache.getHitCount() == 1 && !cache.changed());
+
+    // far vertex: the one farthest from the query
+    glm::vec2 far = vertices[0];
+    for (auto &v : vertices)
+        if (glm::length(v - q) > glm::length(far - q))
+            far = v;
+
+    std::mt19937 gen{ 1 };
+    for (int round = 0; round < 3; round++)
+    {
+        insertIntoLeaf(qt, q, MAX_VERTICES_PER_NODE + 1, gen);
+        insertIntoLeaf(qt, q + glm::vec2(0.02f, 0.0f), 3, gen);
+        insertIntoLeaf(qt, far, 2, gen);
+
+        list = cache.approxBH(qt, q);
+        CHECK(cache.changed());
+        CHECK(cache.getRebuildCount() == 1);
+        CHECK(cache.getRepairCount() == (size_t)round + 1);
+
+        std::vector<glm::vec3> fresh;
+        qt->approxBH(qt, q, fresh);
+        CHECK(list.size() == fresh.size());
+        glm::vec2 a_list = accelerationFromList(list, q, softening);
+        glm::vec2 a_ref = qt->accelerationBH(qt, q, s_thetaBH, softening);
+        CHECK(glm::length(a_list - a_ref) <= 1e-4f * glm::length(a_ref));
+        sortInteractions(list);
+        sortInteractions(fresh);
+        CHECK(list == fresh);
+    }
+
+    // theta changed
+    float theta = s_thetaBH;
+    s_thetaBH = 0.5f;
+    list = cache.approxBH(qt, q);
+    CHECK(cache.getRebuildCount() == 2 && cache.changed());
+    std::vector<glm::vec3> fresh;
+    qt->approxBH(qt, q, fresh);
+    sortInteractions(list);
+    sortInteractions(fresh);
+    CHECK(list == fresh);
+    s_thetaBH = theta;
+    cache.approxBH(qt, q);
+    CHECK(cache.getRebuildCount() == 3);
+
+    // query changed
+    cache.approxBH(qt, far);
+    CHECK(cache.getRebuildCount() == 4 && cache.changed());
+
+    // more inserts than can be repaired
+    insertIntoLeaf(qt, far, BH_CACHE_MAX_REPAIR + 1, gen);
+    cache.approxBH(qt, far);
+    CHECK(cache.getRebuildCount() == 5 && cache.getRepairCount() == 3);
+}
@@ -0,0 +1,100 @@
+#include <thread>
+
+#include "test.h"
+#include "src/quadtree_builder.h"
+
+
+// True if the count, sum and leaf count of every node are those of its children (or its
+// own vertices, for leaves that aren't aggregates), and children lie inside their parent
+static bool consistentTree(QuadtreeBH *_qt)
+{
+    QuadtreeTraversal t(_qt);
+    while (QuadtreeBH *node = t.next())
+    {
+        if (node->isLeaf())
+        {
+            if (!node->isAggregate() && node->getLocalVertices().size() != node->getVertexCount())
+                return false;
+            if (node->getLeafCount() != 1)
+                return false;
+            continue;
+        }
+
+        uint32_t count = 0, leaves = 0;
+        glm::vec2 total = glm::vec2(0.0f);
+        AABB2 aabb = node->getAABB();
+        for (int i = 0; i < node->getChildCount(); i++)
+        {
+            QuadtreeBH *child = &node->getChildren()[i];
+            count += child->getVertexCount();
+            leaves += child->getLeafCount();
+            total += child->getTotal();
+            if (!child->getVertexCount() || !aabb.contains(child->getAABB()) ||
+                child->getLevel() <= node->getLevel())
+                return false;
+        }
+        glm::vec2 e = total - node->getTotal();
+        if (count != node->getVertexCount() || leaves != node->getLeafCount() ||
+            glm::dot(e, e) > 1e-6f * (float)count * (float)count)
+            return false;
+        t.open(node);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+// Snapshots of the async build, polled until it is done: every one is a consistent tree,
+// complete in mass (the coarse and level snapshots hold aggregates), and the vertex
+// count never decreases; the final tree has the same nodes as a synchronous build
+TEST(async_build_snapshots)
+{
+    // enough vertices for aggregate snapshots below the coarse level (see build())
+    std::vector<glm::vec2> vertices = clusteredVertices(1000, 600, 0.05f, 10);
+    size_t n = vertices.size();
+    std::shared_ptr<QuadtreeAsyncBuild> build = std::make_shared<QuadtreeAsyncBuild>(std::vector<glm::vec2>(vertices), n);
+
+    uint32_t generation = 0;
+    uint32_t seen = 0;
+    uint32_t count = 0;
+    bool consistent = true;
+    bool monotonic = true;
+    std::shared_ptr<QuadtreeBH> snapshot = nullptr;
+    while (true)
+    {
+        // (isDone() before getSnapshot(): the last poll sees the final tree)
+        bool done = build->isDone();
+        uint32_t g = build->getGeneration();
+        if (g != generation)
+        {
+            generation = g;
+            snapshot = build->getSnapshot();
+            if (snapshot == nullptr)
+            {
+                consistent = false;
+                break;
+            }
+            consistent &= consistentTree(snapshot.get());
+            monotonic &= (snapshot->getVertexCount() >= count);
+            count = snapshot->getVertexCount();
+            seen++;
+        }
+        if (done)
+            break;
+        std::this_thread::yield();
+    }
+    CHECK(consistent);
+    CHECK(monotonic);
+    CHECK(seen >= 1);
+    // coarse tree, one aggregate level and the full tree
+    CHECK(build->getGeneration() >= 3);
+    CHECK(count == n);
+
+    std::shared_ptr<QuadtreeBH> final_qt = build->getFuture().get();
+    CHECK(final_qt == snapshot);
+    CHECK(!final_qt->isAggregate() && final_qt->getVertexCount() == n);
+
+    std::shared_ptr<QuadtreeBH> ref = std::make_shared<QuadtreeBH>(n);
+    ref->insert(ref, vertices.data(), vertices.size());
+    CHECK(sameNodes(final_qt.get(), ref.get()));
+    CHECK(final_qt->getLeafCount() == ref->getLeafCount());
+}
@@ -0,0 +1,47 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/quadtree.h"
+
+
+//---------------------------------------------------------------------------------------
+// A compressed tree holds the same vertices as a regular one and gives the same sums,
+// with fewer nodes on data with near-duplicates (no single-child chains)
+TEST(compressed_matches_regular)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(50, 200, 0.05f, 5);
+    for (size_t i = 0; i < vertices.size(); i += 11)
+        vertices.push_back(vertices[i] + glm::vec2(1e-6f, 0.0f));
+
+    std::shared_ptr<QuadtreeBH> regular = std::make_shared<QuadtreeBH>(vertices.size());
+    std::shared_ptr<QuadtreeBH> compressed = std::make_shared<QuadtreeBH>(vertices.size(), AABB2(), QUADTREE_COMPRESSED);
+    for (auto &v : vertices)
+    {
+        regular->insert(regular, v);
+        compressed->insert(compressed, v);
+    }
+    CHECK(compressed->nodeCount(compressed) < regular->nodeCount(regular));
+
+    std::vector<glm::vec2> v_regular, v_compressed;
+    regular->getVertices(regular, v_regular);
+    compressed->getVertices(compressed, v_compressed);
+    sortVertices(v_regular);
+    sortVertices(v_compressed);
+    CHECK(v_compressed == v_regular);
+
+    std::vector<glm::vec3> v_BH;
+    for (size_t i = 0; i < vertices.size(); i += 97)
+    {
+        v_BH.clear();
+        compressed->approxBH(compressed, vertices[i], v_BH);
+        float mass = 0.0f;
+        for (auto &v : v_BH)
+            mass += v.z;
+        CHECK(mass == (float)vertices.size());
+
+        // direct summation in both, up to the order of the terms
+        glm::vec2 a0 = regular->accelerationBH(regular, vertices[i], 0.0f, 1e-3f);
+        glm::vec2 a1 = compressed->accelerationBH(compressed, vertices[i], 0.0f, 1e-3f);
+        CHECK(glm::length(a1 - a0) <= 1e-4f * glm::length(a0));
+    }
+}
@@ -0,0 +1,92 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/quadtree.h"
+
+
+// RMS relative error of accelerationBH() against direct summation, at every
+// _stride:th vertex
+static float rmsErrorBH(QuadtreeBH *_qt,
+                        const std::vector<glm::vec2> &_vertices,
+                        const std::vector<glm::vec2> &_a_ref,
+                        size_t _stride,
+                        BHOpening _opening,
+                        float _softening)
+{
+    double err2 = 0.0;
+    size_t n = 0;
+    for (size_t i = 0; i < _vertices.size(); i += _stride, n++)
+    {
+        _opening.accel = glm::length(_a_ref[i]);
+        glm::vec2 a = _qt->accelerationBH(_qt, _vertices[i], _opening, _softening);
+        float e = glm::length(a - _a_ref[i]) / std::max(glm::length(_a_ref[i]), 1e-30f);
+        err2 += e * e;
+    }
+    return (float)sqrt(err2 / n);
+}
+
+//---------------------------------------------------------------------------------------
+// Accuracy of the opening criteria against direct summation: exact without opening,
+// and decreasing error for tighter parameters
+TEST(criteria_converge_to_direct_sum)
+{
+    const float softening = 1e-3f;
+    const float eps2 = softening * softening;
+    const size_t stride = 37;
+    std::vector<glm::vec2> vertices = clusteredVertices(30, 100, 0.05f);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    std::vector<glm::vec2> a_ref(vertices.size(), glm::vec2(0.0f));
+    for (size_t i = 0; i < vertices.size(); i += stride)
+        for (auto &w : vertices)
+        {
+            glm::vec2 d = w - vertices[i];
+            float r2 = glm::dot(d, d) + eps2;
+            a_ref[i] += d / (r2 * sqrtf(r2));
+        }
+
+    QuadtreeBH *root = qt.get();
+    CHECK(rmsErrorBH(root, vertices, a_ref, stride, BHOpening(0.0f), softening) < 1e-4f);
+
+    struct criterion_t { BHCriterion criterion; std::vector<float> params; };
+    std::vector<criterion_t> criteria =
+    {
+        { BH_CRITERION_GEOMETRIC, { 1.0f, 0.5f, 0.25f } },
+        { BH_CRITERION_BMAX,      { 1.0f, 0.5f, 0.25f } },
+        { BH_CRITERION_RELATIVE,  { 0.02f, 0.005f, 0.0005f } },
+    };
+    for (auto &c : criteria)
+    {
+        float prev = INFINITY;
+        for (float param : c.params)
+        {
+            float e = rmsErrorBH(root, vertices, a_ref, stride, BHOpening(c.criterion, param, param), softening);
+            CHECK(e < prev);
+            prev = e;
+        }
+        CHECK(prev < 0.01f);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// The relative criterion falls back to the geometric one while the previous
+// acceleration is unknown (0)
+TEST(criteria_relative_fallback)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(10, 100, 0.05f);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    std::vector<glm::vec3> v_geometric, v_relative;
+    for (size_t i = 0; i < vertices.size(); i += 11)
+    {
+        v_geometric.clear();
+        v_relative.clear();
+        qt->approxBH(qt, vertices[i], BHOpening(BH_CRITERION_GEOMETRIC, 0.5f), v_geometric);
+        qt->approxBH(qt, vertices[i], BHOpening(BH_CRITERION_RELATIVE, 0.5f, 0.005f, 0.0f), v_relative);
+        CHECK(v_geometric == v_relative);
+    }
+}
@@ -0,0 +1,97 @@
+#include "test.h"
+#include "src/quadtree.h"
+
+
+// Leaf AABBs from 8 line vertices per leaf (see QuadtreeBH::getAABBLines()), as vec4s
+static std::vector<glm::vec4> leafAABBs(const glm::vec2 *_lines, size_t _count)
+{
+    std::vector<glm::vec4> aabbs;
+    for (size_t i = 0; i + 8 <= _count; i += 8)
+        aabbs.push_back(glm::vec4(_lines[i], _lines[i + 3]));
+    return aabbs;
+}
+
+//---------------------------------------------------------------------------------------
+// Culled getVertices()/getAABBLines() against a brute-force AABB2::contains() and
+// AABB2::intersects() filter of the full extraction
+TEST(culling_matches_brute_force)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(100, 200, 0.05f, 10);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    std::vector<glm::vec2> all_vertices, all_lines;
+    qt->getVertices(qt, all_vertices);
+    qt->getAABBLines(qt, all_lines);
+    CHECK(all_vertices.size() == vertices.size());
+    std::vector<glm::vec4> all_aabbs = leafAABBs(all_lines.data(), all_lines.size());
+
+    std::vector<glm::vec2> v_buffer(all_vertices.size());
+    std::vector<glm::vec2> aabb_buffer(all_lines.size());
+    std::vector<AABB2> views =
+    {
+        AABB2(),
+        AABB2(-2.0f, 2.0f, -2.0f, 2.0f),
+        AABB2(1.5f, 2.0f, 1.5f, 2.0f),
+        AABB2(-0.5f, 0.5f, -0.5f, 0.5f),
+        AABB2(0.0f, 1.0f, -1.0f, 0.0f),     // on node boundaries
+    };
+    for (size_t i = 0; i < all_vertices.size(); i += all_vertices.size() / 8)
+    {
+        glm::vec2 c = all_vertices[i];
+        for (float e : { 0.2f, 0.05f, 0.001f })
+            views.push_back(AABB2(c - glm::vec2(e), c + glm::vec2(e)));
+    }
+
+    for (auto &view : views)
+    {
+        std::vector<glm::vec2> ref_vertices;
+        for (auto &v : all_vertices)
+            if (view.contains(v))
+                ref_vertices.push_back(v);
+        std::vector<glm::vec4> ref_aabbs;
+        for (auto &a : all_aabbs)
+            if (view.intersects(AABB2(glm::vec2(a.x, a.y), glm::vec2(a.z, a.w))))
+                ref_aabbs.push_back(a);
+
+        size_t v_count = 0;
+        size_t aabb_count = 0;
+        qt->getVertices(qt, view, v_buffer.data(), v_buffer.size(), v_count);
+        qt->getAABBLines(qt, view, aabb_buffer.data(), aabb_buffer.size(), aabb_count);
+
+        std::vector<glm::vec2> culled_vertices(v_buffer.begin(), v_buffer.begin() + v_count);
+        sortVertices(culled_vertices);
+        sortVertices(ref_vertices);
+        CHECK(culled_vertices == ref_vertices);
+        CHECK(aabb_count % 8 == 0);
+        CHECK(leafAABBs(aabb_buffer.data(), aabb_count) == ref_aabbs);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Culled extraction into a buffer that is too small: filled up to _max_count (starting
+// at _out_count), nothing written past it
+TEST(culling_respects_max_count)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(20, 100);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    const glm::vec2 sentinel = glm::vec2(-9.0f);
+    AABB2 view;
+    std::vector<glm::vec2> buffer(128, sentinel);
+    size_t count = 3;
+    qt->getVertices(qt, view, buffer.data(), 100, count);
+    CHECK(count == 100);
+    CHECK(buffer[0] == sentinel && buffer[2] == sentinel && buffer[3] != sentinel);
+    CHECK(buffer[100] == sentinel);
+
+    // AABB lines are written per whole leaf only
+    std::fill(buffer.begin(), buffer.end(), sentinel);
+    count = 0;
+    qt->getAABBLines(qt, view, buffer.data(), 100, count);
+    CHECK(count == 96);
+    CHECK(buffer[96] == sentinel);
+}
@@ -0,0 +1,37 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/density.h"
+
+
+//---------------------------------------------------------------------------------------
+// Density grids from the tree against binning every vertex (half-open cells), for the
+// whole tree, and a region not aligned to the nodes
+TEST(density_matches_binning)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(50, 200, 0.05f, 10);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    std::vector<uint32_t> grid;
+    for (AABB2 region : { AABB2(), AABB2(-0.37f, 0.71f, -0.52f, 0.29f) })
+    {
+        for (uint32_t res : { 1, 16, 100, 256 })
+        {
+            rasterizeDensity(qt, region, res, res, grid);
+
+            std::vector<uint32_t> binned((size_t)res * res, 0);
+            glm::vec2 inv_cell = glm::vec2((float)res) / (region.v1 - region.v0);
+            for (auto &v : vertices)
+            {
+                glm::vec2 c = (v - region.v0) * inv_cell;
+                int x = (int)floorf(c.x);
+                int y = (int)floorf(c.y);
+                if (x >= 0 && x < (int)res && y >= 0 && y < (int)res)
+                    binned[(size_t)y * res + x]++;
+            }
+            CHECK(grid == binned);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#include "test.h"
+#include "src/quadtree.h"
+
+
+//---------------------------------------------------------------------------------------
+// Point location through the hashed index: every vertex is found in the leaf that holds
+// it (including vertices on the upper edges of the root), nothing outside the root
+TEST(index_locates_every_vertex)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(40, 200, 0.05f, 10);
+    vertices.push_back(glm::vec2(1.0f, 1.0f));
+    vertices.push_back(glm::vec2(-1.0f, -1.0f));
+
+    for (QuadtreeFlags flags : { QUADTREE_DEFAULT, QUADTREE_QUANTIZED, QUADTREE_COMPRESSED })
+    {
+        std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size(), AABB2(), flags);
+        for (auto &v : vertices)
+            qt->insert(qt, v);
+
+        bool found = true;
+        for (auto &v : vertices)
+        {
+            QuadtreeBH *leaf = qt->getLeaf(qt, v);
+            if (leaf == NULL || !leaf->isLeaf())
+            {
+                found = false;
+                continue;
+            }
+            auto local = leaf->getLocalVertices();
+            found &= (std::find(local.begin(), local.end(), v) != local.end());
+        }
+        CHECK(found);
+        CHECK(qt->getLeaf(qt, glm::vec2(1.5f, 0.0f)) == NULL);
+        CHECK(qt->getLeaf(qt, glm::vec2(0.0f, -1.01f)) == NULL);
+    }
+}
@@ -0,0 +1,67 @@
+#include "test.h"
+#include "src/quadtree.h"
+
+
+// Everything the queries see of a tree: vertices and leaf AABBs in traversal order,
+// node count and the interaction lists of a few queries
+struct TreeSnapshot
+{
+    TreeSnapshot(QuadtreeBH *_qt, const std::vector<glm::vec2> &_queries)
+    {
+        _qt->getVertices(_qt, vertices);
+        _qt->getAABBs(_qt, aabbs);
+        nodes = _qt->nodeCount(_qt);
+        for (auto &q : _queries)
+            _qt->approxBH(_qt, q, v_BH);
+    }
+
+    bool operator==(const TreeSnapshot &_s) const
+    {
+        return (vertices == _s.vertices && aabbs == _s.aabbs && nodes == _s.nodes && v_BH == _s.v_BH);
+    }
+
+    std::vector<glm::vec2> vertices;
+    std::vector<glm::vec4> aabbs;
+    size_t nodes;
+    std::vector<glm::vec3> v_BH;
+};
+
+//---------------------------------------------------------------------------------------
+// Compaction into each layout leaves all query results unchanged, point location
+// through the index still works, and the tree still takes inserts
+TEST(layout_compaction_preserves_queries)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(40, 200, 0.05f, 10);
+    std::vector<glm::vec2> more = clusteredVertices(10, 200, 0.05f, 0, 2);
+    std::vector<glm::vec2> queries(vertices.begin(), vertices.begin() + 50);
+
+    std::shared_ptr<QuadtreeBH> ref = std::make_shared<QuadtreeBH>(vertices.size() + more.size());
+    for (auto &v : vertices)
+        ref->insert(ref, v);
+    TreeSnapshot before(ref.get(), queries);
+    for (auto &v : more)
+        ref->insert(ref, v);
+    TreeSnapshot after(ref.get(), queries);
+
+    for (QuadtreeLayout layout : { QUADTREE_LAYOUT_DFS, QUADTREE_LAYOUT_BFS, QUADTREE_LAYOUT_VEB })
+    {
+        std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size() + more.size());
+        for (auto &v : vertices)
+            qt->insert(qt, v);
+        qt->compact(qt, layout);
+        CHECK(TreeSnapshot(qt.get(), queries) == before);
+
+        bool found = true;
+        for (auto &v : vertices)
+            found &= (qt->getLeaf(qt, v) != NULL);
+        CHECK(found);
+
+        for (auto &v : more)
+            qt->insert(qt, v);
+        CHECK(TreeSnapshot(qt.get(), queries) == after);
+
+        // compacting again, over a tree already in a node pool
+        qt->compact(qt, layout);
+        CHECK(TreeSnapshot(qt.get(), queries) == after);
+    }
+}
@@ -0,0 +1,53 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/nbody.h"
+
+
+//---------------------------------------------------------------------------------------
+// Two equal bodies on a circular orbit around their center of mass: after a quarter of
+// the period they are still at distance 1 and have moved by 90 degrees
+TEST(nbody_circular_orbit)
+{
+    NBodyParams params;
+    params.mass = 1.0f;
+    params.softening = 1e-4f;
+    params.dt = 1e-3f;
+    float v = sqrtf(0.5f);     // v^2 / r = m / d^2, with r = 0.5, d = 1
+    NBodySimulation sim({ glm::vec2(-0.5f, 0.0f), glm::vec2(0.5f, 0.0f) },
+                        { glm::vec2(0.0f, -v), glm::vec2(0.0f, v) },
+                        params);
+
+    float quarter = 0.25f * 2.0f * (float)M_PI * 0.5f / v;
+    sim.run((size_t)(quarter / params.dt + 0.5f));
+
+    const std::vector<glm::vec2> &p = sim.getPositions();
+    CHECK(fabsf(glm::length(p[1] - p[0]) - 1.0f) < 1e-3f);
+    CHECK(glm::length(p[0] + p[1]) < 1e-4f);
+    CHECK(glm::length(p[1] - glm::vec2(0.0f, 0.5f)) < 1e-2f);
+    CHECK(sim.getTimings().steps == (size_t)(quarter / params.dt + 0.5f));
+}
+
+//---------------------------------------------------------------------------------------
+// With theta = 0 every interaction is direct, and pairwise forces cancel: the total
+// momentum of bodies starting at rest stays (close to) zero
+TEST(nbody_direct_momentum_conservation)
+{
+    std::vector<glm::vec2> positions = clusteredVertices(10, 50, 0.05f);
+    NBodyParams params;
+    params.theta = 0.0f;
+    params.mass = 1.0f / (float)positions.size();
+    params.softening = 1e-2f;
+    NBodySimulation sim(positions, std::vector<glm::vec2>(), params);
+    sim.run(10);
+
+    glm::vec2 momentum = glm::vec2(0.0f);
+    float speed = 0.0f;
+    for (auto &v : sim.getVelocities())
+    {
+        momentum += v;
+        speed += glm::length(v);
+    }
+    CHECK(speed > 0.0f);
+    CHECK(glm::length(momentum) < 1e-4f * speed);
+}
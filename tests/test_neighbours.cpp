@@ -0,0 +1,42 @@
+#include "test.h"
+#include "src/neighbours.h"
+
+
+//---------------------------------------------------------------------------------------
+// Fixed-radius self-join against all pairs within the radius (inclusive, duplicates of
+// a vertex being its neighbours, the vertex itself not)
+TEST(neighbours_match_brute_force)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(20, 200, 0.05f, 10);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+    std::vector<glm::vec2> ordered;
+    qt->getVertices(qt, ordered);
+    size_t n = ordered.size();
+
+    NeighbourLists lists;
+    for (float r : { 0.0f, 0.005f, 0.02f, 0.1f })
+    {
+        fixedRadiusNeighbours(qt, r, lists);
+        CHECK(lists.offsets.size() == n + 1);
+        CHECK(lists.offsets[n] == lists.indices.size());
+
+        bool same = true;
+        std::vector<uint32_t> ref, found;
+        for (size_t i = 0; i < n && same; i++)
+        {
+            ref.clear();
+            for (size_t j = 0; j < n; j++)
+            {
+                glm::vec2 d = ordered[j] - ordered[i];
+                if (j != i && glm::dot(d, d) <= r * r)
+                    ref.push_back((uint32_t)j);
+            }
+            found.assign(lists.indices.begin() + lists.offsets[i], lists.indices.begin() + lists.offsets[i + 1]);
+            std::sort(found.begin(), found.end());
+            same = (found == ref);
+        }
+        CHECK(same);
+    }
+}
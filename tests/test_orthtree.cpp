@@ -0,0 +1,137 @@
+#include "test.h"
+#include "src/quadtree.h"
+
+
+// Normally distributed vertices in [-1, 1]^3, some of them duplicated
+static std::vector<glm::vec3> octreeVertices(size_t _n, uint32_t _seed=1)
+{
+    std::mt19937 gen{ _seed };
+    std::normal_distribution<float> norm{ 0.0f, 0.25f };
+    std::vector<glm::vec3> vertices(_n);
+    for (size_t i = 0; i < _n; i++)
+    {
+        if (i % 100 == 99)
+            vertices[i] = vertices[i - 1];
+        else
+            vertices[i] = glm::clamp(glm::vec3(norm(gen), norm(gen), norm(gen)), -1.0f, 1.0f);
+    }
+    return vertices;
+}
+
+//---------------------------------------------------------------------------------------
+// The octree (OrthtreeBH<3>) keeps all vertices, with the aggregates of every node
+// matching its subtree, for single and batch inserts and in every mode
+TEST(octree_insert)
+{
+    std::vector<glm::vec3> vertices = octreeVertices(20000);
+
+    for (QuadtreeFlags flags : { QUADTREE_DEFAULT, QUADTREE_COMPRESSED, QUADTREE_QUANTIZED })
+    {
+        std::shared_ptr<OctreeBH> single = std::make_shared<OctreeBH>(vertices.size(), AABB3(), flags);
+        for (auto &v : vertices)
+            single->insert(single, v);
+        std::shared_ptr<OctreeBH> batch = std::make_shared<OctreeBH>(vertices.size(), AABB3(), flags);
+        batch->insert(batch, vertices.data(), vertices.size());
+
+        for (auto qt : { single, batch })
+        {
+            CHECK(qt->getVertexCount() == vertices.size());
+            std::vector<glm::vec3> v_qt;
+            qt->getVertices(qt, v_qt);
+            CHECK(v_qt.size() == vertices.size());
+
+            bool consistent = true;
+            OrthtreeTraversal<3> t(qt.get());
+            while (OctreeBH *node = t.next())
+            {
+                size_t n = node->isLeaf() ? node->getLocalVertices().size() : 0;
+                for (int i = 0; i < node->getChildCount(); i++)
+                    n += node->getChildren()[i].getVertexCount();
+                consistent &= (node->isAggregate() || n == node->getVertexCount());
+                consistent &= ((uint32_t)node->getChildCount() <= OctreeBH::CHILD_COUNT);
+                t.open(node);
+            }
+            CHECK(consistent);
+
+            bool found = true;
+            for (size_t i = 0; i < vertices.size(); i += 101)
+            {
+                OctreeBH *leaf = qt->getLeaf(qt, vertices[i]);
+                found &= (leaf != NULL && leaf->getAABB().contains(vertices[i]));
+            }
+            CHECK(found);
+        }
+        CHECK(single->getLeafCount() == batch->getLeafCount());
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Vertices within a view are those of a brute-force test, and the leaf boxes are output
+// as 12 edges each
+TEST(octree_culling)
+{
+    std::vector<glm::vec3> vertices = octreeVertices(20000, 2);
+    std::shared_ptr<OctreeBH> qt = std::make_shared<OctreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    AABB3 view(glm::vec3(-0.3f, -0.1f, 0.0f), glm::vec3(0.2f, 0.5f, 0.25f));
+    std::vector<glm::vec3> v_ref;
+    for (auto &v : vertices)
+        if (view.contains(v))
+            v_ref.push_back(v);
+
+    std::vector<glm::vec3> v_view(vertices.size());
+    size_t count = 0;
+    qt->getVertices(qt, view, v_view.data(), v_view.size(), count);
+    v_view.resize(count);
+    auto less = [](const glm::vec3 &_a, const glm::vec3 &_b)
+    {
+        return (_a.x < _b.x || (_a.x == _b.x && (_a.y < _b.y || (_a.y == _b.y && _a.z < _b.z))));
+    };
+    std::sort(v_ref.begin(), v_ref.end(), less);
+    std::sort(v_view.begin(), v_view.end(), less);
+    CHECK(v_view == v_ref);
+
+    std::vector<glm::vec3> lines;
+    qt->getAABBLines(qt, lines);
+    CHECK(OctreeBH::AABB_LINE_VERTICES == 24);
+    CHECK(lines.size() == 24 * qt->getLeafCount());
+    std::vector<AABB3> aabbs;
+    qt->getAABBs(qt, aabbs);
+    CHECK(aabbs.size() == qt->getLeafCount());
+}
+
+//---------------------------------------------------------------------------------------
+// With theta = 0 every node is opened, and the acceleration is the direct sum
+TEST(octree_acceleration_exact)
+{
+    std::vector<glm::vec3> vertices = octreeVertices(2000, 3);
+    std::shared_ptr<OctreeBH> qt = std::make_shared<OctreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    const float softening = 1e-2f;
+    float max_error = 0.0f;
+    for (size_t i = 0; i < vertices.size(); i += 37)
+    {
+        glm::vec3 a_ref = glm::vec3(0.0f);
+        for (auto &w : vertices)
+        {
+            glm::vec3 d = w - vertices[i];
+            float r2 = glm::dot(d, d) + softening * softening;
+            a_ref += d * (1.0f / (r2 * sqrtf(r2)));
+        }
+        glm::vec3 a = qt->accelerationBH(qt, vertices[i], 0.0f, softening);
+        max_error = std::max(max_error, glm::length(a - a_ref) / glm::length(a_ref));
+    }
+    CHECK(max_error < 1e-4f);
+
+    // the default opening angle still approximates the sum
+    std::vector<glm::vec4> v_bh;
+    qt->approxBH(qt, vertices[0], v_bh);
+    float mass = 0.0f;
+    for (auto &v : v_bh)
+        mass += v.w;
+    CHECK(mass == (float)vertices.size());
+}
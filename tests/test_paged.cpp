@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "src/paged_quadtree.h"
+
+
+// Writes a paged tree of _vertices to a new temporary file, returns its path ("" on
+// failure)
+static std::string buildPaged(const std::vector<glm::vec2> &_vertices, const PagedBuildParams &_params)
+{
+    char path[] = "/tmp/quadtree_tests_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return "";
+    close(fd);
+
+    size_t pos = 0;
+    bool ok = PagedQuadtree::build(path,
+                                   [&](glm::vec2 *_buffer, size_t _max_count)
+                                   {
+                                       size_t n = std::min(_max_count, _vertices.size() - pos);
+                                       std::copy(_vertices.begin() + pos, _vertices.begin() + pos + n, _buffer);
+                                       pos += n;
+                                       return n;
+                                   },
+                                   AABB2(),
+                                   _params);
+    if (!ok)
+    {
+        remove(path);
+        return "";
+    }
+    return path;
+}
+
+//---------------------------------------------------------------------------------------
+// Queries on a paged tree, built in several sort runs and read through a cache much
+// smaller than the file, against brute force
+TEST(paged_queries_match_brute_force)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(100, 500, 0.05f, 10);
+    // a bucket of duplicates larger than a page
+    vertices.insert(vertices.end(), 3000, glm::vec2(0.25f, 0.25f));
+    PagedBuildParams params;
+    params.pageSize = 16 * 1024;
+    params.sortRun = 10000;
+    std::string path = buildPaged(vertices, params);
+    CHECK(!path.empty());
+    if (path.empty())
+        return;
+
+    PagedQuadtree paged(path, 0);
+    CHECK(paged.isOpen());
+    CHECK(paged.getVertexCount() == vertices.size());
+    paged.setCacheBudget(std::max(paged.getPageCount() / 16, (size_t)1) * params.pageSize);
+
+    std::mt19937 gen{ 2 };
+    std::uniform_real_distribution<float> uniform{ -1.0f, 1.0f };
+    std::vector<glm::vec3> v_BH;
+    std::vector<glm::vec2> found, ref;
+    for (int i = 0; i < 100; i++)
+    {
+        glm::vec2 c = (i % 2) ? vertices[i * 997 % vertices.size()] : glm::vec2(uniform(gen), uniform(gen));
+
+        v_BH.clear();
+        CHECK(paged.approxBH(c, v_BH));
+        float mass = 0.0f;
+        for (auto &v : v_BH)
+            mass += v.z;
+        CHECK(mass == (float)vertices.size());
+
+        AABB2 region(c - glm::vec2(0.05f), c + glm::vec2(0.1f));
+        found.clear();
+        ref.clear();
+        CHECK(paged.getVertices(region, found));
+        for (auto &v : vertices)
+            if (region.contains(v))
+                ref.push_back(v);
+        sortVertices(found);
+        sortVertices(ref);
+        CHECK(found == ref);
+
+        // the same distances, closest first (ties in any order)
+        const size_t k = 10;
+        found.clear();
+        CHECK(paged.nearest(c, k, found));
+        std::vector<float> d_found, d_ref;
+        for (auto &v : found)
+            d_found.push_back(glm::dot(v - c, v - c));
+        for (auto &v : vertices)
+            d_ref.push_back(glm::dot(v - c, v - c));
+        std::partial_sort(d_ref.begin(), d_ref.begin() + k, d_ref.end());
+        d_ref.resize(k);
+        CHECK(d_found == d_ref);
+
+        CHECK(paged.getCacheStats().bytesCached <= paged.getCacheBudget());
+    }
+    CHECK(paged.getCacheStats().evictions > 0);
+    CHECK(paged.getCacheStats().readErrors == 0);
+    remove(path.c_str());
+}
+
+//---------------------------------------------------------------------------------------
+// Pages that can't be read (a truncated file) fail the queries, and aren't cached
+TEST(paged_read_errors)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(100, 500, 0.05f);
+    PagedBuildParams params;
+    params.pageSize = 16 * 1024;
+    std::string path = buildPaged(vertices, params);
+    CHECK(!path.empty());
+    if (path.empty())
+        return;
+
+    PagedQuadtree paged(path, 1 << 20);
+    CHECK(truncate(path.c_str(), paged.getPageCount() / 2 * params.pageSize) == 0);
+
+    std::vector<glm::vec2> found;
+    CHECK(!paged.getVertices(AABB2(), found));
+    CHECK(found.size() < vertices.size());
+    CHECK(paged.getCacheStats().readErrors > 0);
+
+    // retried, rather than served from the cache
+    uint64_t errors = paged.getCacheStats().readErrors;
+    found.clear();
+    CHECK(!paged.getVertices(AABB2(), found));
+    CHECK(paged.getCacheStats().readErrors > errors);
+    remove(path.c_str());
+}
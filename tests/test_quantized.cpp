@@ -0,0 +1,65 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/quadtree.h"
+
+
+// Clustered vertices, plus vertices on and next to (but further than the quantization 
+// step of 2^-31 of the root) the node midpoints of the top levels
+static std::vector<glm::vec2> midpointVertices()
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(50, 200, 0.05f, 10);
+    for (int i = -15; i <= 15; i++)
+    {
+        float m = i / 16.0f;
+        for (float x : { m - 1e-7f, m, m + 1e-7f })
+            vertices.push_back(glm::vec2(x, 0.3f * m));
+    }
+    return vertices;
+}
+
+//---------------------------------------------------------------------------------------
+// Fixed-point descent doesn't depend on the insertion order: the same vertices,
+// shuffled, give the same nodes
+TEST(quantized_independent_of_order)
+{
+    std::vector<glm::vec2> vertices = midpointVertices();
+    std::vector<glm::vec2> shuffled = vertices;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{ 1 });
+
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size(), AABB2(), QUADTREE_QUANTIZED);
+    std::shared_ptr<QuadtreeBH> qt_shuffled = std::make_shared<QuadtreeBH>(vertices.size(), AABB2(), QUADTREE_QUANTIZED);
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        qt->insert(qt, vertices[i]);
+        qt_shuffled->insert(qt_shuffled, shuffled[i]);
+    }
+    CHECK(sameNodes(qt.get(), qt_shuffled.get()));
+}
+
+//---------------------------------------------------------------------------------------
+// Every vertex is located in a leaf whose AABB contains it (closed at the upper edges of
+// the root only), also next to midpoints, where float descent may disagree
+TEST(quantized_leaves_contain_their_vertices)
+{
+    std::vector<glm::vec2> vertices = midpointVertices();
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size(), AABB2(), QUADTREE_QUANTIZED);
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    AABB2 root = qt->getAABB();
+    bool contained = true;
+    for (auto &v : vertices)
+    {
+        QuadtreeBH *leaf = qt->getLeaf(qt, v);
+        if (leaf == NULL)
+        {
+            contained = false;
+            continue;
+        }
+        AABB2 aabb = leaf->getAABB();
+        contained &= (v.x >= aabb.v0.x && v.y >= aabb.v0.y &&
+                      (v.x < aabb.v1.x || v.x == root.v1.x) && (v.y < aabb.v1.y || v.y == root.v1.y));
+    }
+    CHECK(contained);
+}
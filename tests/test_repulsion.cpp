@@ -0,0 +1,104 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/repulsion.h"
+
+
+// Z = sum_{i != j} q_ij and the unnormalized forces sum_{j != i} q_ij^2 (y_i - y_j), by
+// direct summation
+static double directRepulsion(const std::vector<glm::vec2> &_vertices, std::vector<glm::vec2> &_out_forces)
+{
+    double z = 0.0;
+    _out_forces.assign(_vertices.size(), glm::vec2(0.0f));
+    for (size_t i = 0; i < _vertices.size(); i++)
+    {
+        glm::dvec2 f = glm::dvec2(0.0);
+        for (size_t j = 0; j < _vertices.size(); j++)
+        {
+            if (j == i)
+                continue;
+            glm::dvec2 d = glm::dvec2(_vertices[i] - _vertices[j]);
+            double q = 1.0 / (1.0 + glm::dot(d, d));
+            z += q;
+            f += d * (q * q);
+        }
+        _out_forces[i] = glm::vec2(f);
+    }
+    return z;
+}
+
+// RMS relative error of the forces, normalized by the RMS of the reference forces
+static float forceError(const std::vector<glm::vec2> &_f, const std::vector<glm::vec2> &_f_ref)
+{
+    double err2 = 0.0, ref2 = 0.0;
+    for (size_t i = 0; i < _f.size(); i++)
+    {
+        glm::vec2 e = _f[i] - _f_ref[i];
+        err2 += glm::dot(e, e);
+        ref2 += glm::dot(_f_ref[i], _f_ref[i]);
+    }
+    return (float)sqrt(err2 / ref2);
+}
+
+//---------------------------------------------------------------------------------------
+// Forces and Z of repulsionBH() against direct summation, without self-interactions:
+// exact at theta = 0, and close also at opening angles where the node holding a vertex
+// may be approximated (theta > 1 / sqrt(2)). On the scale of an embedding ([-20, 20]^2),
+// where q falls off within the clusters. Every 10th vertex is a duplicate of its 
+// cluster center, which does interact with the other copies (q = 1).
+TEST(repulsion_matches_direct_sum)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(20, 100, 0.05f, 10);
+    for (auto &v : vertices)
+        v *= 20.0f;
+    AABB2 aabb(glm::vec2(-20.0f), glm::vec2(20.0f));
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size(), aabb);
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    std::vector<glm::vec2> f_ref;
+    double z_ref = directRepulsion(vertices, f_ref);
+
+    struct tolerance_t { float theta; float z; float f; };
+    for (tolerance_t t : { tolerance_t{ 0.0f, 1e-5f, 1e-4f },
+                           tolerance_t{ 0.5f, 1e-2f, 2e-2f },
+                           tolerance_t{ 1.0f, 5e-2f, 1e-1f },
+                           tolerance_t{ 1.5f, 0.15f, 0.4f } })
+    {
+        std::vector<glm::vec2> f(vertices.size());
+        float z = repulsionBH(qt, vertices.data(), vertices.size(), t.theta, f.data());
+        CHECK(fabs(z - z_ref) / z_ref < t.z);
+        CHECK(forceError(f, f_ref) < t.f);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// A vertex whose leaf is approximated as a whole: the contribution of that leaf is the
+// other vertices only, as if the vertex weren't in the tree at all
+TEST(repulsion_excludes_self_from_aggregates)
+{
+    // two clusters far apart; at a large opening angle every leaf is a single aggregate
+    // for its own vertices
+    std::vector<glm::vec2> vertices = clusteredVertices(2, 50, 0.01f);
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+
+    const float theta = 100.0f;
+    bool consistent = true;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        std::shared_ptr<QuadtreeBH> others = std::make_shared<QuadtreeBH>(vertices.size());
+        for (size_t j = 0; j < vertices.size(); j++)
+            if (j != i)
+                others->insert(others, vertices[j]);
+
+        // (the root of either tree is approximated: a single aggregate interaction)
+        glm::vec2 f, f_ref;
+        float z = qt->repulsionBH(qt, vertices[i], theta, f, true);
+        float z_ref = others->repulsionBH(others, vertices[i], theta, f_ref);
+        consistent &= (fabs(z - z_ref) <= 1e-4f * z_ref);
+        consistent &= (glm::length(f - f_ref) <= 1e-3f * glm::length(f_ref) + 1e-6f);
+    }
+    CHECK(consistent);
+}
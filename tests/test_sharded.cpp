@@ -0,0 +1,56 @@
+#include <math.h>
+
+#include "test.h"
+#include "src/sharded.h"
+
+
+//---------------------------------------------------------------------------------------
+// Sharded (multi-process) accelerations against direct summation: exact with theta = 0
+// (every LET holds all remote vertices), and close to the single-tree error otherwise
+TEST(sharded_matches_direct_sum)
+{
+    std::vector<glm::vec2> vertices = clusteredVertices(20, 200, 0.1f);
+    ShardedParams params;
+    const float eps2 = params.softening * params.softening;
+
+    std::vector<glm::vec2> a_ref(vertices.size(), glm::vec2(0.0f));
+    for (size_t i = 0; i < vertices.size(); i++)
+        for (auto &w : vertices)
+        {
+            glm::vec2 d = w - vertices[i];
+            float r2 = glm::dot(d, d) + eps2;
+            a_ref[i] += d / (r2 * sqrtf(r2));
+        }
+    auto rms_error = [&](const std::vector<glm::vec2> &_a)
+    {
+        double err2 = 0.0;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            float e = glm::length(_a[i] - a_ref[i]) / std::max(glm::length(a_ref[i]), 1e-30f);
+            err2 += e * e;
+        }
+        return (float)sqrt(err2 / vertices.size());
+    };
+
+    std::shared_ptr<QuadtreeBH> qt = std::make_shared<QuadtreeBH>(vertices.size());
+    for (auto &v : vertices)
+        qt->insert(qt, v);
+    std::vector<glm::vec2> a_tree(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        a_tree[i] = qt->accelerationBH(qt, vertices[i], params.theta, params.softening);
+    float e_tree = rms_error(a_tree);
+
+    std::vector<glm::vec2> accelerations;
+    for (size_t shards : { 1, 2, 4 })
+    {
+        params.shards = shards;
+        params.theta = 0.0f;
+        CHECK(shardedAccelerationBH(vertices, AABB2(), params, accelerations));
+        CHECK(accelerations.size() == vertices.size());
+        CHECK(rms_error(accelerations) < 1e-4f);
+
+        params.theta = 0.5f;
+        CHECK(shardedAccelerationBH(vertices, AABB2(), params, accelerations));
+        CHECK(rms_error(accelerations) < 1.25f * e_tree);
+    }
+}